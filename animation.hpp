@@ -0,0 +1,230 @@
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+#include <assimp/scene.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <skeleton.hpp>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// One animated node. The keys themselves live in the clip's flat arrays,
+// a track only remembers where its run of keys starts and how long it is.
+struct AnimationTrack
+{
+    int nodeIndex;
+    unsigned int positionStart, positionCount;
+    unsigned int rotationStart, rotationCount;
+    unsigned int scaleStart, scaleCount;
+};
+
+// Per-instance playback state: the key each track landed on last time, so
+// sampling in time order only ever has to step forward by one key.
+struct AnimationCursor
+{
+    vector<unsigned int> position;
+    vector<unsigned int> rotation;
+    vector<unsigned int> scale;
+
+    void Reset(size_t trackCount)
+    {
+        position.assign(trackCount, 0);
+        rotation.assign(trackCount, 0);
+        scale.assign(trackCount, 0);
+    }
+};
+
+class AnimationClip
+{
+public:
+    string name;
+    float duration;
+    float ticksPerSecond;
+    vector<AnimationTrack> tracks;
+
+    // Key times are in ticks. Positions and scales are packed xyz, rotations wxyz.
+    vector<float> positionTimes;
+    vector<float> positionValues;
+    vector<float> rotationTimes;
+    vector<float> rotationValues;
+    vector<float> scaleTimes;
+    vector<float> scaleValues;
+
+    AnimationClip() : duration(0.0f), ticksPerSecond(25.0f) {}
+
+    // Channels are resolved against the skeleton once here, so sampling never touches a node name.
+    AnimationClip(const aiAnimation* animation, const Skeleton& skeleton)
+    {
+        name = animation->mName.C_Str();
+        duration = (float)animation->mDuration;
+        ticksPerSecond = animation->mTicksPerSecond != 0 ? (float)animation->mTicksPerSecond : 25.0f;
+
+        for (unsigned int i = 0; i < animation->mNumChannels; i++)
+        {
+            const aiNodeAnim* channel = animation->mChannels[i];
+            int nodeIndex = skeleton.FindNode(channel->mNodeName.C_Str());
+            if (nodeIndex < 0)
+            {
+                cout << "DEBUG: Animation " << name << " channel " << channel->mNodeName.C_Str() << " has no matching node" << endl;
+                continue;
+            }
+
+            AnimationTrack track;
+            track.nodeIndex = nodeIndex;
+
+            track.positionStart = positionTimes.size();
+            track.positionCount = channel->mNumPositionKeys;
+            for (unsigned int k = 0; k < channel->mNumPositionKeys; k++)
+            {
+                const aiVectorKey& key = channel->mPositionKeys[k];
+                positionTimes.push_back((float)key.mTime);
+                positionValues.push_back(key.mValue.x);
+                positionValues.push_back(key.mValue.y);
+                positionValues.push_back(key.mValue.z);
+            }
+
+            track.rotationStart = rotationTimes.size();
+            track.rotationCount = channel->mNumRotationKeys;
+            for (unsigned int k = 0; k < channel->mNumRotationKeys; k++)
+            {
+                const aiQuatKey& key = channel->mRotationKeys[k];
+                rotationTimes.push_back((float)key.mTime);
+                rotationValues.push_back(key.mValue.w);
+                rotationValues.push_back(key.mValue.x);
+                rotationValues.push_back(key.mValue.y);
+                rotationValues.push_back(key.mValue.z);
+            }
+
+            track.scaleStart = scaleTimes.size();
+            track.scaleCount = channel->mNumScalingKeys;
+            for (unsigned int k = 0; k < channel->mNumScalingKeys; k++)
+            {
+                const aiVectorKey& key = channel->mScalingKeys[k];
+                scaleTimes.push_back((float)key.mTime);
+                scaleValues.push_back(key.mValue.x);
+                scaleValues.push_back(key.mValue.y);
+                scaleValues.push_back(key.mValue.z);
+            }
+
+            tracks.push_back(track);
+        }
+    }
+
+    float GetDurationSeconds() const { return duration / ticksPerSecond; }
+
+    float GetAnimationTime(float currentTime) const
+    {
+        float timeInTicks = currentTime * ticksPerSecond;
+        return fmod(timeInTicks, duration);
+    }
+
+    // Overwrites the local transform of every animated node. Nodes without a
+    // track keep whatever the caller put there (normally the bind pose).
+    void Sample(float animationTime, vector<glm::mat4>& localTransforms, AnimationCursor& cursor) const
+    {
+        if (cursor.position.size() != tracks.size())
+            cursor.Reset(tracks.size());
+
+        for (size_t i = 0; i < tracks.size(); i++)
+        {
+            const AnimationTrack& track = tracks[i];
+            glm::mat4 translation = InterpolateTranslation(animationTime, track, cursor.position[i]);
+            glm::mat4 rotation = InterpolateRotation(animationTime, track, cursor.rotation[i]);
+            glm::mat4 scale = InterpolateScaling(animationTime, track, cursor.scale[i]);
+            localTransforms[track.nodeIndex] = translation * rotation * scale;
+        }
+    }
+
+    void Sample(float animationTime, vector<glm::mat4>& localTransforms) const
+    {
+        AnimationCursor cursor;
+        Sample(animationTime, localTransforms, cursor);
+    }
+
+private:
+    glm::vec3 GetVec(const vector<float>& values, unsigned int key) const
+    {
+        return glm::vec3(values[key * 3], values[key * 3 + 1], values[key * 3 + 2]);
+    }
+
+    glm::quat GetQuat(unsigned int key) const
+    {
+        return glm::quat(rotationValues[key * 4], rotationValues[key * 4 + 1], rotationValues[key * 4 + 2], rotationValues[key * 4 + 3]);
+    }
+
+    glm::mat4 InterpolateTranslation(float animationTime, const AnimationTrack& track, unsigned int& cursor) const
+    {
+        if (track.positionCount == 1)
+            return glm::translate(glm::mat4(1.0f), GetVec(positionValues, track.positionStart));
+
+        unsigned int p0Index = track.positionStart + GetKeyIndex(animationTime, &positionTimes[track.positionStart], track.positionCount, cursor);
+        unsigned int p1Index = p0Index + 1;
+        float lerpFactor = GetLerpFactor(animationTime, positionTimes[p0Index], positionTimes[p1Index]);
+        glm::vec3 finalTranslation = glm::mix(GetVec(positionValues, p0Index), GetVec(positionValues, p1Index), lerpFactor);
+        return glm::translate(glm::mat4(1.0f), finalTranslation);
+    }
+
+    glm::mat4 InterpolateRotation(float animationTime, const AnimationTrack& track, unsigned int& cursor) const
+    {
+        if (track.rotationCount == 1)
+            return glm::mat4_cast(GetQuat(track.rotationStart));
+
+        unsigned int r0Index = track.rotationStart + GetKeyIndex(animationTime, &rotationTimes[track.rotationStart], track.rotationCount, cursor);
+        unsigned int r1Index = r0Index + 1;
+        float lerpFactor = GetLerpFactor(animationTime, rotationTimes[r0Index], rotationTimes[r1Index]);
+        glm::quat finalRotation = glm::slerp(GetQuat(r0Index), GetQuat(r1Index), lerpFactor);
+        return glm::mat4_cast(finalRotation);
+    }
+
+    glm::mat4 InterpolateScaling(float animationTime, const AnimationTrack& track, unsigned int& cursor) const
+    {
+        if (track.scaleCount == 1)
+            return glm::scale(glm::mat4(1.0f), GetVec(scaleValues, track.scaleStart));
+
+        unsigned int s0Index = track.scaleStart + GetKeyIndex(animationTime, &scaleTimes[track.scaleStart], track.scaleCount, cursor);
+        unsigned int s1Index = s0Index + 1;
+        float lerpFactor = GetLerpFactor(animationTime, scaleTimes[s0Index], scaleTimes[s1Index]);
+        glm::vec3 finalScale = glm::mix(GetVec(scaleValues, s0Index), GetVec(scaleValues, s1Index), lerpFactor);
+        return glm::scale(glm::mat4(1.0f), finalScale);
+    }
+
+    float GetLerpFactor(float animationTime, float lastTimeStamp, float nextTimeStamp) const
+    {
+        float midWayLength = animationTime - lastTimeStamp;
+        float framesDiff = nextTimeStamp - lastTimeStamp;
+        if (framesDiff <= 0.0f)
+            return 0.0f;
+        return glm::clamp(midWayLength / framesDiff, 0.0f, 1.0f);
+    }
+
+    // Returns k with times[k] <= animationTime < times[k + 1], clamped to the
+    // first and last key pair. Tries the cached key and its successor first and
+    // only falls back to a binary search when the time jumped (loop or seek).
+    unsigned int GetKeyIndex(float animationTime, const float* times, unsigned int count, unsigned int& cursor) const
+    {
+        unsigned int last = count - 2;
+        if (animationTime <= times[0])
+            return cursor = 0;
+        if (animationTime >= times[count - 1])
+            return cursor = last;
+
+        unsigned int index = cursor <= last ? cursor : 0;
+        if (times[index] <= animationTime)
+        {
+            if (animationTime < times[index + 1])
+                return index;
+            if (index + 1 <= last && animationTime < times[index + 2])
+                return cursor = index + 1;
+        }
+
+        index = (unsigned int)(upper_bound(times, times + count, animationTime) - times) - 1;
+        return cursor = min(index, last);
+    }
+};
+
+#endif
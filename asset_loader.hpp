@@ -0,0 +1,181 @@
+#ifndef ASSET_LOADER_HPP
+#define ASSET_LOADER_HPP
+
+#include <model.hpp>
+#include <cooked_model.hpp>
+#include <texture_cache.hpp>
+#include <thread_pool.hpp>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+enum class AssetState
+{
+    Loading,
+    Ready,
+    Failed
+};
+
+template <typename T>
+struct AssetSlot
+{
+    string name;
+    AssetState state = AssetState::Loading;
+    unique_ptr<T> asset;
+};
+
+// Shared reference to an asset that may still be loading. The state only changes on
+// the GL thread (in AssetLoader::Pump), so checking it needs no synchronisation.
+template <typename T>
+class AssetHandle
+{
+public:
+    AssetHandle() {}
+    AssetHandle(shared_ptr<AssetSlot<T>> slot) : slot(slot) {}
+
+    bool IsReady() const { return slot && slot->state == AssetState::Ready; }
+    bool IsFailed() const { return slot && slot->state == AssetState::Failed; }
+    const string& GetName() const { return slot->name; }
+
+    // nullptr until ready
+    T* Get() const { return IsReady() ? slot->asset.get() : nullptr; }
+    T* operator->() const { return Get(); }
+    T& operator*() const { return *Get(); }
+
+private:
+    shared_ptr<AssetSlot<T>> slot;
+};
+
+// Background asset loading for a render loop that starts before anything is loaded.
+// Each load is split into a CPU half, run on the thread pool, and a finishing step
+// that is queued back to the GL thread and run by Pump, so a scene fills in frame
+// by frame while the caller draws placeholders for handles that aren't ready yet.
+class AssetLoader
+{
+public:
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    static AssetLoader& Get()
+    {
+        static AssetLoader* loader = new AssetLoader();
+        return *loader;
+    }
+
+    // load runs on a worker and fills data; finish runs on the GL thread with the same
+    // data and returns the asset, or nullptr for a failed load.
+    template <typename Data, typename T>
+    AssetHandle<T> Load(const string& name, function<bool(Data&)> load, function<unique_ptr<T>(Data&, bool)> finish)
+    {
+        shared_ptr<AssetSlot<T>> slot = make_shared<AssetSlot<T>>();
+        slot->name = name;
+        pending++;
+        auto start = chrono::steady_clock::now();
+        GetThreadPool().Submit([this, slot, load, finish, start]
+        {
+            shared_ptr<Data> data = make_shared<Data>();
+            bool loaded = load(*data);
+            double loadMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            completions.Push([slot, finish, data, loaded, loadMs]
+            {
+                auto finishStart = chrono::steady_clock::now();
+                slot->asset = finish(*data, loaded);
+                slot->state = slot->asset ? AssetState::Ready : AssetState::Failed;
+                double finishMs = chrono::duration<double, milli>(chrono::steady_clock::now() - finishStart).count();
+                if (slot->asset)
+                    cout << "DEBUG: Asset " << slot->name << " ready (load " << loadMs << " ms, upload " << finishMs << " ms)" << endl;
+                else
+                    cout << "ERROR: Asset " << slot->name << " failed to load" << endl;
+            });
+        });
+        return AssetHandle<T>(slot);
+    }
+
+    AssetHandle<Model> LoadModel(const string& path, VertexFormat format = VertexFormat::Auto)
+    {
+        return Load<ModelData, Model>(path,
+            [path, format](ModelData& data) { return LoadModelData(path, format, data); },
+            [](ModelData& data, bool loaded) { return loaded ? unique_ptr<Model>(new Model(data)) : unique_ptr<Model>(); });
+    }
+
+    // Textures already stream through TextureCache; the handle becomes ready once its
+    // pixels are resident. Until then, binding TextureCache::Resolve(id) gives the
+    // fallback; a file that exists but fails to decode keeps the fallback and the
+    // handle turns Failed.
+    AssetHandle<unsigned int> LoadTexture(const string& path, const TextureSettings& settings = TextureSettings())
+    {
+        shared_ptr<AssetSlot<unsigned int>> slot = make_shared<AssetSlot<unsigned int>>();
+        slot->name = path;
+        unsigned int id = TextureCache::Get().Acquire(path, settings);
+        if (id == 0)
+            slot->state = AssetState::Failed;
+        else
+        {
+            slot->asset.reset(new unsigned int(id));
+            textures.push_back(slot);
+        }
+        return AssetHandle<unsigned int>(slot);
+    }
+
+    // Runs finished loads on the GL thread. Stops after budgetMs once at least one has
+    // run, so a burst of completions is spread over several frames.
+    void Pump(double budgetMs = 4.0)
+    {
+        TextureCache::Get().PumpUploads();
+        for (size_t i = 0; i < textures.size();)
+        {
+            unsigned int id = *textures[i]->asset;
+            bool resident = TextureCache::Get().IsResident(id);
+            if (resident || TextureCache::Get().IsFailed(id))
+            {
+                textures[i]->state = resident ? AssetState::Ready : AssetState::Failed;
+                if (!resident)
+                    cout << "ERROR: Asset " << textures[i]->name << " failed to load" << endl;
+                textures[i] = textures.back();
+                textures.pop_back();
+            }
+            else
+                i++;
+        }
+
+        auto start = chrono::steady_clock::now();
+        function<void()> completion;
+        while (completions.TryPop(completion))
+        {
+            completion();
+            pending--;
+            if (chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() >= budgetMs)
+                break;
+        }
+    }
+
+    // Blocks until every load submitted so far has finished.
+    void Flush()
+    {
+        while (pending > 0)
+        {
+            Pump(1e9);
+            if (pending > 0)
+                this_thread::sleep_for(chrono::microseconds(200));
+        }
+        TextureCache::Get().Flush();
+    }
+
+    // Loads whose finishing step hasn't run yet; textures are counted by TextureCache.
+    int GetPendingCount() const { return pending; }
+
+private:
+    MPSCQueue<function<void()>> completions;
+    int pending = 0;
+    vector<shared_ptr<AssetSlot<unsigned int>>> textures;
+
+    AssetLoader() {}
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef BONE_PALETTE_HPP
+#define BONE_PALETTE_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+#define BONE_PALETTE_BINDING 0
+
+// Every bone palette used in a frame, packed back to back into one shader storage
+// buffer and uploaded with a single call. shader.vert indexes it with
+// paletteIndex * bonesPerPalette, so there is no fixed bone limit.
+class BonePaletteBuffer
+{
+public:
+    BonePaletteBuffer(int bonesPerPalette) : bonesPerPalette(bonesPerPalette)
+    {
+        glGenBuffers(1, &SSBO);
+    }
+
+    ~BonePaletteBuffer()
+    {
+        glDeleteBuffers(1, &SSBO);
+    }
+
+    BonePaletteBuffer(const BonePaletteBuffer&) = delete;
+    BonePaletteBuffer& operator=(const BonePaletteBuffer&) = delete;
+
+    int GetBonesPerPalette() const { return bonesPerPalette; }
+    int GetPaletteCount() const { return matrices.size() / max(bonesPerPalette, 1); }
+
+    void Begin()
+    {
+        matrices.clear();
+    }
+
+    // Returns the palette index to hand to the shader.
+    int Add(const vector<glm::mat4>& palette)
+    {
+        int index = GetPaletteCount();
+        size_t count = min((size_t)bonesPerPalette, palette.size());
+        matrices.insert(matrices.end(), palette.begin(), palette.begin() + count);
+        matrices.resize((size_t)(index + 1) * bonesPerPalette, glm::mat4(1.0f));
+        return index;
+    }
+
+    void Upload()
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, SSBO);
+        // re-specifying the store orphans last frame's copy, so we never wait on its draws
+        capacity = max(capacity, max(matrices.size(), (size_t)1) * sizeof(glm::mat4));
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW);
+        if (!matrices.empty())
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, matrices.size() * sizeof(glm::mat4), &matrices[0]);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BONE_PALETTE_BINDING, SSBO);
+    }
+
+private:
+    unsigned int SSBO = 0;
+    int bonesPerPalette;
+    size_t capacity = 0;
+    vector<glm::mat4> matrices;
+};
+
+#endif
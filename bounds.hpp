@@ -0,0 +1,84 @@
+#ifndef BOUNDS_HPP
+#define BOUNDS_HPP
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// Axis-aligned box plus a bounding sphere about the box centre. The radius is at most
+// the half diagonal, and tighter when it was measured from the actual points.
+struct Bounds
+{
+    glm::vec3 min = glm::vec3(FLT_MAX);
+    glm::vec3 max = glm::vec3(-FLT_MAX);
+    float radius = 0.0f;
+
+    bool IsEmpty() const { return min.x > max.x; }
+    glm::vec3 GetCenter() const { return (min + max) * 0.5f; }
+    glm::vec3 GetExtents() const { return (max - min) * 0.5f; }
+
+    // Box only; call FitRadius or SetRadiusFromBox afterwards.
+    void Expand(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void Expand(const Bounds& other)
+    {
+        if (other.IsEmpty())
+            return;
+        min = glm::min(min, other.min);
+        max = glm::max(max, other.max);
+        SetRadiusFromBox();
+    }
+
+    void SetRadiusFromBox() { radius = IsEmpty() ? 0.0f : glm::length(GetExtents()); }
+
+    // Shrinks the sphere to the farthest of points from the box centre.
+    void FitRadius(const vector<glm::vec3>& points)
+    {
+        glm::vec3 center = GetCenter();
+        float farthest = 0.0f;
+        for (const glm::vec3& point : points)
+        {
+            glm::vec3 d = point - center;
+            farthest = std::max(farthest, glm::dot(d, d));
+        }
+        radius = std::sqrt(farthest);
+    }
+};
+
+// Largest axis scale of an affine transform, for carrying a radius through it.
+inline float maxScale(const glm::mat4& transform)
+{
+    float x = glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0]));
+    float y = glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1]));
+    float z = glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]));
+    return std::sqrt(std::max(x, std::max(y, z)));
+}
+
+// Box that encloses the transformed box (Arvo); the sphere is carried over directly.
+inline Bounds TransformBounds(const Bounds& bounds, const glm::mat4& transform)
+{
+    Bounds result;
+    if (bounds.IsEmpty())
+        return result;
+    glm::vec3 center = glm::vec3(transform * glm::vec4(bounds.GetCenter(), 1.0f));
+    glm::vec3 extents = bounds.GetExtents();
+    glm::vec3 worldExtents;
+    for (int row = 0; row < 3; row++)
+    {
+        worldExtents[row] = std::fabs(transform[0][row]) * extents.x + std::fabs(transform[1][row]) * extents.y + std::fabs(transform[2][row]) * extents.z;
+    }
+    result.min = center - worldExtents;
+    result.max = center + worldExtents;
+    result.radius = std::min(bounds.radius * maxScale(transform), glm::length(worldExtents));
+    return result;
+}
+
+#endif
@@ -0,0 +1,148 @@
+#ifndef BVH_BENCHMARK_HPP
+#define BVH_BENCHMARK_HPP
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <bounds.hpp>
+#include <frustum.hpp>
+#include <scene_bvh.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <vector>
+using namespace std;
+
+// Times SceneBVH queries against a brute-force loop over the same boxes and checks
+// that both return the same number of hits. Run with: ./main --bench-bvh [objects]
+int RunBVHBenchmark(int objectCount)
+{
+    mt19937 random(1234);
+    uniform_real_distribution<float> position(-1000.0f, 1000.0f);
+    uniform_real_distribution<float> size(0.5f, 4.0f);
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+    vector<Bounds> boxes(objectCount);
+    for (Bounds& box : boxes)
+    {
+        glm::vec3 center(position(random), position(random) * 0.1f, position(random));
+        glm::vec3 extents(size(random));
+        box.min = center - extents;
+        box.max = center + extents;
+        box.SetRadiusFromBox();
+    }
+
+    auto elapsed = [](chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
+
+    SceneBVH bvh;
+    vector<int> ids;
+    for (const Bounds& box : boxes)
+        ids.push_back(bvh.Insert(box));
+    auto start = chrono::steady_clock::now();
+    bvh.Build();
+    cout << "BVH: built " << objectCount << " objects into " << bvh.GetNodeCount() << " nodes in " << elapsed(start) << " ms" << endl;
+
+    const int queries = 200;
+    vector<int> results;
+    double bvhMs = 0.0, bruteMs = 0.0;
+    size_t bvhHits = 0, bruteHits = 0;
+
+    // frustum: cameras scattered over the world looking in random directions
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+    vector<Frustum> frustums;
+    for (int q = 0; q < queries; q++)
+    {
+        glm::vec3 eye(position(random), 10.0f, position(random));
+        glm::vec3 direction(unit(random), unit(random) * 0.2f, unit(random));
+        frustums.push_back(ExtractFrustum(projection * glm::lookAt(eye, eye + direction, glm::vec3(0.0f, 1.0f, 0.0f))));
+    }
+    start = chrono::steady_clock::now();
+    for (const Frustum& frustum : frustums)
+    {
+        bvh.QueryFrustum(frustum, results);
+        bvhHits += results.size();
+    }
+    bvhMs = elapsed(start);
+    start = chrono::steady_clock::now();
+    for (const Frustum& frustum : frustums)
+    {
+        for (const Bounds& box : boxes)
+            bruteHits += frustum.TestBox(box) ? 1 : 0;
+    }
+    bruteMs = elapsed(start);
+    cout << "BVH: frustum " << bvhMs * 1000.0 / queries << " us/query vs brute force " << bruteMs * 1000.0 / queries << " us/query (" << bvhHits << " / " << bruteHits << " hits)" << endl;
+
+    // sphere: proximity queries of gameplay size
+    vector<glm::vec4> spheres;
+    for (int q = 0; q < queries; q++)
+        spheres.push_back(glm::vec4(position(random), 0.0f, position(random), 25.0f));
+    bvhHits = bruteHits = 0;
+    start = chrono::steady_clock::now();
+    for (const glm::vec4& sphere : spheres)
+    {
+        bvh.QuerySphere(glm::vec3(sphere), sphere.w, results);
+        bvhHits += results.size();
+    }
+    bvhMs = elapsed(start);
+    start = chrono::steady_clock::now();
+    for (const glm::vec4& sphere : spheres)
+    {
+        glm::vec3 center(sphere);
+        for (const Bounds& box : boxes)
+        {
+            glm::vec3 d = center - glm::clamp(center, box.min, box.max);
+            bruteHits += glm::dot(d, d) <= sphere.w * sphere.w ? 1 : 0;
+        }
+    }
+    bruteMs = elapsed(start);
+    cout << "BVH: sphere " << bvhMs * 1000.0 / queries << " us/query vs brute force " << bruteMs * 1000.0 / queries << " us/query (" << bvhHits << " / " << bruteHits << " hits)" << endl;
+
+    // box
+    vector<Bounds> regions;
+    for (int q = 0; q < queries; q++)
+    {
+        Bounds region;
+        glm::vec3 center(position(random), 0.0f, position(random));
+        region.min = center - glm::vec3(30.0f);
+        region.max = center + glm::vec3(30.0f);
+        regions.push_back(region);
+    }
+    bvhHits = bruteHits = 0;
+    start = chrono::steady_clock::now();
+    for (const Bounds& region : regions)
+    {
+        bvh.QueryBox(region, results);
+        bvhHits += results.size();
+    }
+    bvhMs = elapsed(start);
+    start = chrono::steady_clock::now();
+    for (const Bounds& region : regions)
+    {
+        for (const Bounds& box : boxes)
+        {
+            bool overlaps = box.min.x <= region.max.x && box.max.x >= region.min.x &&
+                            box.min.y <= region.max.y && box.max.y >= region.min.y &&
+                            box.min.z <= region.max.z && box.max.z >= region.min.z;
+            bruteHits += overlaps ? 1 : 0;
+        }
+    }
+    bruteMs = elapsed(start);
+    cout << "BVH: box " << bvhMs * 1000.0 / queries << " us/query vs brute force " << bruteMs * 1000.0 / queries << " us/query (" << bvhHits << " / " << bruteHits << " hits)" << endl;
+
+    // refit: a tenth of the objects move a little, like a marching army
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < objectCount; i += 10)
+    {
+        boxes[i].min.z -= 0.5f;
+        boxes[i].max.z -= 0.5f;
+        bvh.Update(ids[i], boxes[i]);
+    }
+    bvh.Refresh();
+    cout << "BVH: refit after moving " << (objectCount + 9) / 10 << " objects in " << elapsed(start) << " ms" << endl;
+    return 0;
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include "shader.hpp"
+#include "frustum.hpp"
 
 #include <iostream>
 
@@ -52,6 +53,12 @@ public:
         return glm::lookAt(position, position + front, up);
     }
 
+    // World-space frustum for the given projection and the current view.
+    Frustum GetFrustum(const glm::mat4& projection)
+    {
+        return ExtractFrustum(projection * GetViewMatrix());
+    }
+
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
         float velocity = movementSpeed * deltaTime;
@@ -0,0 +1,500 @@
+#ifndef COOKED_MODEL_HPP
+#define COOKED_MODEL_HPP
+
+#include <model_import.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+#define COOKED_MODEL_VERSION 4
+#define COOKED_MODEL_DIR "model_cache"
+
+// Read-only mapping of a whole file. Unmapped when the last ModelData holding it goes away.
+class MappedFile
+{
+public:
+    MappedFile() {}
+
+    ~MappedFile()
+    {
+        if (bytes)
+            munmap((void*)bytes, length);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+        bytes = (const unsigned char*)mapped;
+        length = info.st_size;
+        return true;
+    }
+
+    const unsigned char* GetData() const { return bytes; }
+    size_t GetSize() const { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+};
+
+// Fixed header at the start of every cooked file. The source size and modification
+// time are what the cooked file was built from; either changing makes it stale.
+struct CookedModelHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t requestedFormat;
+    uint32_t format;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    uint32_t stride;
+    uint32_t padding;
+};
+
+// Mesh vertex and index blocks start on this boundary so they can be uploaded in place.
+#define COOKED_DATA_ALIGNMENT 16
+
+class CookedWriter
+{
+public:
+    vector<unsigned char> bytes;
+
+    void Raw(const void* data, size_t size)
+    {
+        const unsigned char* begin = (const unsigned char*)data;
+        bytes.insert(bytes.end(), begin, begin + size);
+    }
+
+    template <typename T>
+    void Pod(const T& value) { Raw(&value, sizeof(T)); }
+
+    void String(const string& value)
+    {
+        Pod<uint32_t>(value.size());
+        Raw(value.data(), value.size());
+    }
+
+    template <typename T>
+    void Array(const vector<T>& values)
+    {
+        Pod<uint32_t>(values.size());
+        Raw(values.data(), values.size() * sizeof(T));
+    }
+
+    void Align()
+    {
+        while (bytes.size() % COOKED_DATA_ALIGNMENT)
+            bytes.push_back(0);
+    }
+};
+
+// Bounds-checked cursor over a mapped cooked file. Any overrun sets failed and
+// every later read returns zeroes, so callers check once at the end.
+class CookedReader
+{
+public:
+    bool failed = false;
+
+    CookedReader(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+    const unsigned char* Raw(size_t length)
+    {
+        if (failed || length > size - offset)
+        {
+            failed = true;
+            return nullptr;
+        }
+        const unsigned char* at = data + offset;
+        offset += length;
+        return at;
+    }
+
+    template <typename T>
+    T Pod()
+    {
+        T value{};
+        const unsigned char* at = Raw(sizeof(T));
+        if (at)
+            memcpy((void*)&value, at, sizeof(T));
+        return value;
+    }
+
+    string String()
+    {
+        uint32_t length = Pod<uint32_t>();
+        const unsigned char* at = Raw(length);
+        return at ? string((const char*)at, length) : string();
+    }
+
+    template <typename T>
+    vector<T> Array()
+    {
+        uint32_t count = Pod<uint32_t>();
+        if (count > (size - offset) / sizeof(T))
+        {
+            failed = true;
+            return vector<T>();
+        }
+        vector<T> values(count);
+        const unsigned char* at = Raw(count * sizeof(T));
+        if (at)
+            memcpy(values.data(), at, count * sizeof(T));
+        return values;
+    }
+
+    void Align()
+    {
+        size_t aligned = (offset + COOKED_DATA_ALIGNMENT - 1) / COOKED_DATA_ALIGNMENT * COOKED_DATA_ALIGNMENT;
+        Raw(aligned - offset);
+    }
+
+private:
+    const unsigned char* data;
+    size_t size;
+    size_t offset = 0;
+};
+
+// Cooked files are keyed by source path and requested format, under COOKED_MODEL_DIR.
+string CookedModelPath(const string& path, VertexFormat format)
+{
+    uint64_t hash = 14695981039346656037ull;
+    string key = path + "|" + to_string((int)format);
+    for (unsigned char c : key)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.cmdl", (unsigned long long)hash);
+    return string(COOKED_MODEL_DIR) + "/" + name;
+}
+
+bool statSource(const string& path, uint64_t& size, int64_t& time)
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0)
+        return false;
+    size = info.st_size;
+    time = info.st_mtime;
+    return true;
+}
+
+// Serializes an imported model. Written to a temporary file and renamed, so a crash
+// mid-write never leaves a truncated cooked file behind.
+bool WriteCookedModel(const string& cookedPath, VertexFormat requested, const ModelData& data)
+{
+    CookedModelHeader header = {};
+    memcpy(header.magic, "CDMD", 4);
+    header.version = COOKED_MODEL_VERSION;
+    header.requestedFormat = (uint32_t)requested;
+    header.format = (uint32_t)data.format;
+    header.stride = GetVertexLayout(data.format).stride;
+    if (!statSource(data.path, header.sourceSize, header.sourceTime))
+        return false;
+
+    CookedWriter writer;
+    writer.Pod(header);
+
+    writer.Pod<int32_t>(data.boneCounter);
+    writer.Pod<uint32_t>(data.boneInfoMap.size());
+    for (const auto& bone : data.boneInfoMap)
+    {
+        writer.String(bone.first);
+        writer.Pod<int32_t>(bone.second.id);
+        writer.Pod(bone.second.offset);
+    }
+
+    const Skeleton& skeleton = data.skeleton;
+    writer.Pod<uint32_t>(skeleton.names.size());
+    for (const string& name : skeleton.names)
+        writer.String(name);
+    writer.Array(skeleton.parents);
+    writer.Array(skeleton.bindLocal);
+    writer.Array(skeleton.offsets);
+    writer.Array(skeleton.boneIds);
+
+    writer.Pod<uint32_t>(data.animations.size());
+    for (const AnimationClip& clip : data.animations)
+    {
+        writer.String(clip.name);
+        writer.Pod(clip.duration);
+        writer.Pod(clip.ticksPerSecond);
+        writer.Array(clip.tracks);
+        writer.Array(clip.positionTimes);
+        writer.Array(clip.positionValues);
+        writer.Array(clip.rotationTimes);
+        writer.Array(clip.rotationValues);
+        writer.Array(clip.scaleTimes);
+        writer.Array(clip.scaleValues);
+    }
+
+    writer.Pod<uint32_t>(data.materials.size());
+    for (const MaterialDesc& material : data.materials)
+    {
+        writer.Pod(material.baseColor);
+        writer.Pod<uint32_t>(material.textures.size());
+        for (const TextureRef& texture : material.textures)
+        {
+            writer.String(texture.type);
+            writer.String(texture.path);
+        }
+    }
+
+    writer.Pod<uint32_t>(data.meshes.size());
+    for (const MeshData& mesh : data.meshes)
+    {
+        writer.Pod<int32_t>(mesh.material);
+        writer.Pod(mesh.bounds);
+        writer.Pod<uint32_t>(mesh.vertexCount);
+        writer.Pod<uint32_t>(mesh.indexCount);
+        writer.Pod<uint32_t>(mesh.indexType);
+        writer.Align();
+        writer.Raw(mesh.VertexData(), (size_t)mesh.vertexCount * header.stride);
+        writer.Align();
+        writer.Raw(mesh.IndexData(), (size_t)mesh.indexCount * (mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t)));
+    }
+
+    writer.Array(data.occluder.vertices);
+    writer.Array(data.occluder.indices);
+
+    error_code error;
+    filesystem::create_directories(filesystem::path(cookedPath).parent_path(), error);
+    string temporary = cookedPath + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (!file)
+    {
+        cout << "DEBUG: Could not write cooked model " << cookedPath << endl;
+        return false;
+    }
+    bool written = fwrite(writer.bytes.data(), 1, writer.bytes.size(), file) == writer.bytes.size();
+    written = fclose(file) == 0 && written;
+    if (!written || rename(temporary.c_str(), cookedPath.c_str()) != 0)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+    cout << "DEBUG: Cooked " << data.path << " -> " << cookedPath << " (" << writer.bytes.size() / 1024 << " KB)" << endl;
+    return true;
+}
+
+// A track's keys [start, start + count) must exist in both its times and its values
+// (components floats per key); Sample reads them unchecked.
+bool validKeyRange(unsigned int start, unsigned int count, const vector<float>& times, const vector<float>& values, size_t components)
+{
+    uint64_t end = (uint64_t)start + count;
+    return count > 0 && end <= times.size() && end * components <= values.size();
+}
+
+// Every index must name one of the mesh's own vertices; the pool shares its vertex
+// arena between models, so a bad one would draw another model's data (or past it).
+template <typename T>
+bool validIndices(const unsigned char* data, uint32_t count, uint32_t vertexCount)
+{
+    if (!data)
+        return false;
+    const T* indices = (const T*)data;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (indices[i] >= vertexCount)
+            return false;
+    }
+    return true;
+}
+
+// Maps a cooked file and fills data from it. Mesh bytes are not copied: MeshData
+// points into the mapping, which data.mapping keeps alive until the upload is done.
+// Returns false if the file is missing, corrupt, from another version or stale.
+bool ReadCookedModel(const string& cookedPath, const string& sourcePath, VertexFormat requested, ModelData& data)
+{
+    shared_ptr<MappedFile> mapping = make_shared<MappedFile>();
+    if (!mapping->Open(cookedPath))
+        return false;
+
+    CookedReader reader(mapping->GetData(), mapping->GetSize());
+    CookedModelHeader header = reader.Pod<CookedModelHeader>();
+    uint64_t sourceSize = 0;
+    int64_t sourceTime = 0;
+    if (reader.failed || memcmp(header.magic, "CDMD", 4) != 0 || header.version != COOKED_MODEL_VERSION || header.requestedFormat != (uint32_t)requested)
+        return false;
+    // a missing source is fine; the cooked file is all we need
+    if (statSource(sourcePath, sourceSize, sourceTime) && (sourceSize != header.sourceSize || sourceTime != header.sourceTime))
+    {
+        cout << "DEBUG: Cooked model " << cookedPath << " is stale" << endl;
+        return false;
+    }
+    VertexFormat format = (VertexFormat)header.format;
+    if (format != VertexFormat::Full && format != VertexFormat::Skinned && format != VertexFormat::Static)
+        return false;
+    if (header.stride != GetVertexLayout(format).stride)
+        return false;
+
+    ModelData cooked;
+    cooked.path = sourcePath;
+    cooked.format = format;
+
+    cooked.boneCounter = reader.Pod<int32_t>();
+    uint32_t boneCount = reader.Pod<uint32_t>();
+    for (uint32_t i = 0; i < boneCount && !reader.failed; i++)
+    {
+        string name = reader.String();
+        BoneInfo bone;
+        bone.id = reader.Pod<int32_t>();
+        bone.offset = reader.Pod<glm::mat4>();
+        if (bone.id < 0 || bone.id >= cooked.boneCounter)
+            reader.failed = true;
+        cooked.boneInfoMap[name] = bone;
+    }
+
+    Skeleton& skeleton = cooked.skeleton;
+    uint32_t nodeCount = reader.Pod<uint32_t>();
+    for (uint32_t i = 0; i < nodeCount && !reader.failed; i++)
+        skeleton.names.push_back(reader.String());
+    skeleton.parents = reader.Array<int>();
+    skeleton.bindLocal = reader.Array<glm::mat4>();
+    skeleton.offsets = reader.Array<glm::mat4>();
+    skeleton.boneIds = reader.Array<int>();
+    // ComputeBoneTransforms walks these in parallel and needs parents before children
+    if (skeleton.names.size() != nodeCount || skeleton.parents.size() != nodeCount || skeleton.bindLocal.size() != nodeCount ||
+        skeleton.offsets.size() != nodeCount || skeleton.boneIds.size() != nodeCount)
+        reader.failed = true;
+    for (uint32_t i = 0; i < nodeCount && !reader.failed; i++)
+    {
+        if (skeleton.parents[i] < -1 || skeleton.parents[i] >= (int)i || skeleton.boneIds[i] < -1 || skeleton.boneIds[i] >= cooked.boneCounter)
+            reader.failed = true;
+    }
+    skeleton.RebuildLookup();
+
+    uint32_t clipCount = reader.Pod<uint32_t>();
+    for (uint32_t i = 0; i < clipCount && !reader.failed; i++)
+    {
+        AnimationClip clip;
+        clip.name = reader.String();
+        clip.duration = reader.Pod<float>();
+        clip.ticksPerSecond = reader.Pod<float>();
+        clip.tracks = reader.Array<AnimationTrack>();
+        clip.positionTimes = reader.Array<float>();
+        clip.positionValues = reader.Array<float>();
+        clip.rotationTimes = reader.Array<float>();
+        clip.rotationValues = reader.Array<float>();
+        clip.scaleTimes = reader.Array<float>();
+        clip.scaleValues = reader.Array<float>();
+        for (const AnimationTrack& track : clip.tracks)
+        {
+            if (track.nodeIndex < 0 || track.nodeIndex >= (int)nodeCount ||
+                !validKeyRange(track.positionStart, track.positionCount, clip.positionTimes, clip.positionValues, 3) ||
+                !validKeyRange(track.rotationStart, track.rotationCount, clip.rotationTimes, clip.rotationValues, 4) ||
+                !validKeyRange(track.scaleStart, track.scaleCount, clip.scaleTimes, clip.scaleValues, 3))
+                reader.failed = true;
+        }
+        cooked.animations.push_back(move(clip));
+    }
+
+    uint32_t materialCount = reader.Pod<uint32_t>();
+    for (uint32_t i = 0; i < materialCount && !reader.failed; i++)
+    {
+        MaterialDesc material;
+        material.baseColor = reader.Pod<glm::vec4>();
+        uint32_t textureCount = reader.Pod<uint32_t>();
+        for (uint32_t j = 0; j < textureCount && !reader.failed; j++)
+        {
+            TextureRef texture;
+            texture.type = reader.String();
+            texture.path = reader.String();
+            material.textures.push_back(texture);
+        }
+        cooked.materials.push_back(material);
+    }
+
+    uint32_t meshCount = reader.Pod<uint32_t>();
+    for (uint32_t i = 0; i < meshCount && !reader.failed; i++)
+    {
+        MeshData mesh;
+        mesh.material = reader.Pod<int32_t>();
+        mesh.bounds = reader.Pod<Bounds>();
+        mesh.vertexCount = reader.Pod<uint32_t>();
+        mesh.indexCount = reader.Pod<uint32_t>();
+        mesh.indexType = reader.Pod<uint32_t>();
+        if (mesh.indexType != GL_UNSIGNED_SHORT && mesh.indexType != GL_UNSIGNED_INT)
+        {
+            reader.failed = true;
+            break;
+        }
+        reader.Align();
+        mesh.mappedVertices = reader.Raw((size_t)mesh.vertexCount * header.stride);
+        reader.Align();
+        mesh.mappedIndices = reader.Raw((size_t)mesh.indexCount * (mesh.indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t)));
+        bool indicesValid = mesh.indexType == GL_UNSIGNED_SHORT ?
+            validIndices<uint16_t>(mesh.mappedIndices, mesh.indexCount, mesh.vertexCount) :
+            validIndices<uint32_t>(mesh.mappedIndices, mesh.indexCount, mesh.vertexCount);
+        if (mesh.material < 0 || mesh.material >= (int)cooked.materials.size() || !indicesValid)
+            reader.failed = true;
+        cooked.meshes.push_back(move(mesh));
+    }
+
+    cooked.occluder.vertices = reader.Array<glm::vec3>();
+    cooked.occluder.indices = reader.Array<unsigned int>();
+    for (unsigned int index : cooked.occluder.indices)
+    {
+        if (index >= cooked.occluder.vertices.size())
+            reader.failed = true;
+    }
+
+    if (reader.failed)
+    {
+        cout << "DEBUG: Cooked model " << cookedPath << " is corrupt" << endl;
+        return false;
+    }
+    cooked.mapping = mapping;
+    data = move(cooked);
+    return true;
+}
+
+// Loads from the cooked file when it is up to date, otherwise imports through
+// Assimp and re-cooks so the next run takes the fast path.
+bool LoadModelData(const string& path, VertexFormat format, ModelData& data)
+{
+    auto start = chrono::steady_clock::now();
+    string cookedPath = CookedModelPath(path, format);
+    if (ReadCookedModel(cookedPath, path, format, data))
+    {
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << "DEBUG: Loaded cooked model " << cookedPath << " for " << path << " in " << ms << " ms" << endl;
+        return true;
+    }
+
+    if (!ModelImporter::Import(path, format, data))
+        return false;
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << "DEBUG: Imported " << path << " in " << ms << " ms" << endl;
+    WriteCookedModel(cookedPath, format, data);
+    return true;
+}
+
+#endif
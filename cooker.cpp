@@ -0,0 +1,51 @@
+#include <cooked_model.hpp>
+
+#include <iostream>
+#include <string>
+using namespace std;
+
+// Offline asset cooker: imports each model through Assimp and writes the cooked
+// file the runtime looks for (CookedModelPath). Run it from the directory the game
+// runs in, since cooked files live in a relative model_cache/.
+//
+//   cooker [--format=auto|full|skinned|static] model.fbx [model.gltf ...]
+int main(int argc, char** argv)
+{
+    VertexFormat format = VertexFormat::Auto;
+    int cooked = 0, failed = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg.rfind("--format=", 0) == 0)
+        {
+            string name = arg.substr(9);
+            if (name == "auto") format = VertexFormat::Auto;
+            else if (name == "full") format = VertexFormat::Full;
+            else if (name == "skinned") format = VertexFormat::Skinned;
+            else if (name == "static") format = VertexFormat::Static;
+            else
+            {
+                cout << "Unknown vertex format " << name << endl;
+                return 1;
+            }
+            continue;
+        }
+
+        ModelData data;
+        if (ModelImporter::Import(arg, format, data) && WriteCookedModel(CookedModelPath(arg, format), format, data))
+            cooked++;
+        else
+        {
+            cout << "FAILED: Could not cook " << arg << endl;
+            failed++;
+        }
+    }
+
+    if (cooked + failed == 0)
+    {
+        cout << "Usage: " << argv[0] << " [--format=auto|full|skinned|static] model [model ...]" << endl;
+        return 1;
+    }
+    cout << "Cooked " << cooked << " model(s), " << failed << " failed" << endl;
+    return failed ? 1 : 0;
+}
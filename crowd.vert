@@ -0,0 +1,85 @@
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in ivec4 boneIds;
+layout (location = 6) in vec4 weights;
+layout (location = 7) in mat4 instanceModel;
+layout (location = 12) in vec2 instancePhaseSpeed;
+
+out vec2 TexCoords;
+out vec3 FragPos;
+out vec3 Normal;
+flat out int HasTexture;
+
+// Shared per-frame camera and light state (FrameUniforms)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+// Baked bone palettes: row = frame, 4 texels per bone (matrix columns)
+uniform sampler2D boneTexture;
+uniform int boneCount;
+uniform int boneFrameCount;
+uniform float boneFramesPerSecond;
+uniform float time;
+
+// Per-draw data of the current multi-draw (MultiDrawBuffer); drawBase is the batch's first command
+struct DrawData
+{
+    int hasTexture;
+    int padding[3];
+};
+layout (std430, binding = 1) readonly buffer DrawParameters
+{
+    DrawData draws[];
+};
+uniform int drawBase;
+
+const int MAX_BONE_INFLUENCE = 4;
+
+mat4 fetchBone(int bone, int frame)
+{
+    return mat4(texelFetch(boneTexture, ivec2(bone * 4 + 0, frame), 0),
+                texelFetch(boneTexture, ivec2(bone * 4 + 1, frame), 0),
+                texelFetch(boneTexture, ivec2(bone * 4 + 2, frame), 0),
+                texelFetch(boneTexture, ivec2(bone * 4 + 3, frame), 0));
+}
+
+void main()
+{
+    float framePos = (time * instancePhaseSpeed.y + instancePhaseSpeed.x) * boneFramesPerSecond;
+    int frame0 = int(mod(floor(framePos), float(boneFrameCount)));
+    int frame1 = (frame0 + 1) % boneFrameCount;
+    float blend = fract(framePos);
+
+    vec4 totalPosition = vec4(0.0f);
+    vec3 totalNormal = vec3(0.0f);
+    for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
+    {
+        if(boneIds[i] == -1)
+            continue;
+        if(boneIds[i] >= boneCount)
+        {
+            totalPosition = vec4(aPos,1.0f);
+            totalNormal = aNormal;
+            break;
+        }
+        mat4 boneMatrix = fetchBone(boneIds[i], frame0) * (1.0 - blend) + fetchBone(boneIds[i], frame1) * blend;
+        totalPosition += boneMatrix * vec4(aPos,1.0f) * weights[i];
+        totalNormal += mat3(boneMatrix) * aNormal * weights[i];
+    }
+
+    mat4 model = instanceModel;
+    HasTexture = draws[drawBase + gl_DrawIDARB].hasTexture;
+    TexCoords = aTexCoords;
+    FragPos = vec3(model * totalPosition);
+    Normal = mat3(transpose(inverse(model))) * totalNormal;
+    gl_Position = projection * view * model * totalPosition;
+}
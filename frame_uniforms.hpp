@@ -0,0 +1,60 @@
+#ifndef FRAME_UNIFORMS_HPP
+#define FRAME_UNIFORMS_HPP
+
+#include <glad/glad.h>
+#include <gl_state.hpp>
+#include <glm/glm.hpp>
+#include <shader.hpp>
+
+// Mirrors the std140 FrameData block declared by every scene shader.
+// vec3s are padded to vec4 to match std140 alignment.
+struct FrameUniformData
+{
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec4 viewPos;
+    glm::vec4 lightPos;
+    glm::vec4 lightColor;
+};
+
+// Camera and light state written once per frame into a uniform buffer bound at
+// FRAME_UNIFORMS_BINDING. Shader binds its FrameData block there after linking.
+class FrameUniforms
+{
+public:
+    FrameUniforms()
+    {
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniformData), NULL, GL_DYNAMIC_DRAW);
+        GetGLState().BindUniformBuffer(FRAME_UNIFORMS_BINDING, UBO);
+    }
+
+    ~FrameUniforms()
+    {
+        GetGLState().ForgetBuffer(UBO);
+        glDeleteBuffers(1, &UBO);
+    }
+
+    FrameUniforms(const FrameUniforms&) = delete;
+    FrameUniforms& operator=(const FrameUniforms&) = delete;
+
+    void Update(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& viewPos, const glm::vec3& lightPos, const glm::vec3& lightColor)
+    {
+        FrameUniformData data;
+        data.projection = projection;
+        data.view = view;
+        data.viewPos = glm::vec4(viewPos, 1.0f);
+        data.lightPos = glm::vec4(lightPos, 1.0f);
+        data.lightColor = glm::vec4(lightColor, 1.0f);
+
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniformData), &data, GL_DYNAMIC_DRAW);
+        GetGLState().BindUniformBuffer(FRAME_UNIFORMS_BINDING, UBO);
+    }
+
+private:
+    unsigned int UBO = 0;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include <glm/glm.hpp>
+#include <bounds.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define FRUSTUM_SIMD 1
+#endif
+using namespace std;
+
+// Six normalised planes (xyz normal pointing inwards, w distance): left, right,
+// bottom, top, near, far. A point p is inside a plane when dot(n, p) + w >= 0.
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    bool TestSphere(const glm::vec3& center, float radius) const
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+                return false;
+        }
+        return true;
+    }
+
+    // Conservative: only rejects boxes entirely behind one plane.
+    bool TestBox(const Bounds& bounds) const
+    {
+        glm::vec3 center = bounds.GetCenter();
+        glm::vec3 extents = bounds.GetExtents();
+        for (int i = 0; i < 6; i++)
+        {
+            glm::vec3 normal = glm::vec3(planes[i]);
+            float reach = glm::dot(glm::abs(normal), extents);
+            if (glm::dot(normal, center) + planes[i].w < -reach)
+                return false;
+        }
+        return true;
+    }
+};
+
+// Gribb/Hartmann extraction from a combined projection * view (or projection * view * model) matrix.
+inline Frustum ExtractFrustum(const glm::mat4& viewProjection)
+{
+    const glm::mat4& m = viewProjection;
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0;
+    frustum.planes[1] = row3 - row0;
+    frustum.planes[2] = row3 + row1;
+    frustum.planes[3] = row3 - row1;
+    frustum.planes[4] = row3 + row2;
+    frustum.planes[5] = row3 - row2;
+    for (int i = 0; i < 6; i++)
+    {
+        float length = glm::length(glm::vec3(frustum.planes[i]));
+        if (length > 0.0f)
+            frustum.planes[i] = frustum.planes[i] / length;
+    }
+    return frustum;
+}
+
+struct CullStats
+{
+    unsigned int visible = 0;
+    unsigned int culled = 0;
+    // in the frustum but hidden behind an occluder (see occlusion_culler.hpp)
+    unsigned int occluded = 0;
+
+    void Add(const CullStats& other)
+    {
+        visible += other.visible;
+        culled += other.culled;
+        occluded += other.occluded;
+    }
+};
+
+// Batched sphere-vs-frustum test. Spheres are stored as separate x/y/z/radius arrays
+// so four of them go through each plane per SSE instruction; without SSE2 the same
+// loop runs one sphere at a time. Fill with Add, then Cull once per frame.
+class FrustumCuller
+{
+public:
+    void Clear()
+    {
+        centerX.clear();
+        centerY.clear();
+        centerZ.clear();
+        radii.clear();
+    }
+
+    void Reserve(size_t count)
+    {
+        centerX.reserve(count + 3);
+        centerY.reserve(count + 3);
+        centerZ.reserve(count + 3);
+        radii.reserve(count + 3);
+    }
+
+    unsigned int Add(const glm::vec3& center, float radius)
+    {
+        centerX.push_back(center.x);
+        centerY.push_back(center.y);
+        centerZ.push_back(center.z);
+        radii.push_back(radius);
+        return radii.size() - 1;
+    }
+
+    size_t GetCount() const { return radii.size(); }
+
+    // visible[i] is 1 for every sphere that touches the frustum, 0 otherwise.
+    CullStats Cull(const Frustum& frustum, vector<uint8_t>& visible)
+    {
+        size_t count = radii.size();
+        visible.resize(count);
+        CullStats stats;
+        if (count == 0)
+            return stats;
+
+        size_t i = 0;
+#ifdef FRUSTUM_SIMD
+        // pad to a multiple of four; the padding lanes are never written out
+        size_t padded = (count + 3) & ~(size_t)3;
+        centerX.resize(padded, 0.0f);
+        centerY.resize(padded, 0.0f);
+        centerZ.resize(padded, 0.0f);
+        radii.resize(padded, 0.0f);
+
+        __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+        for (int p = 0; p < 6; p++)
+        {
+            planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+            planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+            planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+            planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+        }
+        for (; i < count; i += 4)
+        {
+            __m128 x = _mm_loadu_ps(&centerX[i]);
+            __m128 y = _mm_loadu_ps(&centerY[i]);
+            __m128 z = _mm_loadu_ps(&centerZ[i]);
+            __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(&radii[i]));
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; p++)
+            {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p])), _mm_add_ps(_mm_mul_ps(z, planeZ[p]), planeW[p]));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+            }
+            int mask = _mm_movemask_ps(inside);
+            for (int lane = 0; lane < 4 && i + lane < count; lane++)
+                visible[i + lane] = (mask >> lane) & 1;
+        }
+
+        centerX.resize(count);
+        centerY.resize(count);
+        centerZ.resize(count);
+        radii.resize(count);
+#endif
+        for (; i < count; i++)
+            visible[i] = frustum.TestSphere(glm::vec3(centerX[i], centerY[i], centerZ[i]), radii[i]) ? 1 : 0;
+
+        for (size_t v = 0; v < count; v++)
+            stats.visible += visible[v];
+        stats.culled = count - stats.visible;
+        return stats;
+    }
+
+private:
+    vector<float> centerX, centerY, centerZ, radii;
+};
+
+#endif
@@ -0,0 +1,273 @@
+#ifndef GEOMETRY_POOL_HPP
+#define GEOMETRY_POOL_HPP
+
+#include <glad/glad.h>
+#include <gl_state.hpp>
+#include <glm/glm.hpp>
+#include <vertex_layout.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+using namespace std;
+
+#define INSTANCE_ATTRIB_LOCATION 7
+#define GEOMETRY_VERTEX_BINDING 0
+#define GEOMETRY_INSTANCE_BINDING 1
+#define DRAW_DATA_BINDING 1
+
+// Per-instance vertex data for instanced draws. The model matrix takes locations
+// 7-10, paletteIndex 11 and (phase, speed) 12; all advance once per instance.
+struct InstanceData
+{
+    glm::mat4 model;
+    int paletteIndex;
+    float phase;
+    float speed;
+    float padding;
+};
+
+// Layout of one glMultiDrawElementsIndirect record.
+struct DrawElementsIndirectCommand
+{
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+// Per-draw shader data, read in shader.vert as draws[drawBase + gl_DrawIDARB].
+struct DrawData
+{
+    int hasTexture;
+    int padding[3];
+};
+
+// One vertex layout and index type worth of geometry: a shared vertex buffer, a shared
+// index buffer and the VAO that reads them. Instance data is bound to its own binding
+// point per draw, so every mesh and instance buffer goes through the same VAO.
+class GeometryArena
+{
+public:
+    GeometryArena(const VertexLayout& layout, GLenum indexType) : layout(layout), indexType(indexType)
+    {
+        indexSize = indexType == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        vertexCapacity = 1 << 16;
+        indexCapacity = 1 << 18;
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, (size_t)vertexCapacity * layout.stride, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        GetGLState().BindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (size_t)indexCapacity * indexSize, NULL, GL_STATIC_DRAW);
+        glBindVertexBuffer(GEOMETRY_VERTEX_BINDING, VBO, 0, layout.stride);
+        for (const VertexAttribute& attribute : layout.attributes)
+        {
+            glEnableVertexAttribArray(attribute.location);
+            if (attribute.integer)
+                glVertexAttribIFormat(attribute.location, attribute.components, attribute.type, attribute.offset);
+            else
+                glVertexAttribFormat(attribute.location, attribute.components, attribute.type, attribute.normalized, attribute.offset);
+            glVertexAttribBinding(attribute.location, GEOMETRY_VERTEX_BINDING);
+        }
+
+        for (int i = 0; i < 4; i++)
+        {
+            glEnableVertexAttribArray(INSTANCE_ATTRIB_LOCATION + i);
+            glVertexAttribFormat(INSTANCE_ATTRIB_LOCATION + i, 4, GL_FLOAT, GL_FALSE, offsetof(InstanceData, model) + i * sizeof(glm::vec4));
+            glVertexAttribBinding(INSTANCE_ATTRIB_LOCATION + i, GEOMETRY_INSTANCE_BINDING);
+        }
+        glEnableVertexAttribArray(INSTANCE_ATTRIB_LOCATION + 4);
+        glVertexAttribIFormat(INSTANCE_ATTRIB_LOCATION + 4, 1, GL_INT, offsetof(InstanceData, paletteIndex));
+        glVertexAttribBinding(INSTANCE_ATTRIB_LOCATION + 4, GEOMETRY_INSTANCE_BINDING);
+        glEnableVertexAttribArray(INSTANCE_ATTRIB_LOCATION + 5);
+        glVertexAttribFormat(INSTANCE_ATTRIB_LOCATION + 5, 2, GL_FLOAT, GL_FALSE, offsetof(InstanceData, phase));
+        glVertexAttribBinding(INSTANCE_ATTRIB_LOCATION + 5, GEOMETRY_INSTANCE_BINDING);
+        glVertexBindingDivisor(GEOMETRY_INSTANCE_BINDING, 1);
+    }
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    unsigned int GetVAO() const { return VAO; }
+    GLenum GetIndexType() const { return indexType; }
+    size_t GetIndexSize() const { return indexSize; }
+    const VertexLayout& GetLayout() const { return layout; }
+
+    // Appends packed vertices and indices; returns (baseVertex, firstIndex).
+    pair<unsigned int, unsigned int> Append(const void* vertexData, unsigned int vertexCount, const void* indexData, unsigned int indexCount)
+    {
+        if (vertexCount + vertexUsed > vertexCapacity || indexCount + indexUsed > indexCapacity)
+            grow(vertexUsed + vertexCount, indexUsed + indexCount);
+
+        pair<unsigned int, unsigned int> offsets(vertexUsed, indexUsed);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, (size_t)vertexUsed * layout.stride, (size_t)vertexCount * layout.stride, vertexData);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, (size_t)indexUsed * indexSize, (size_t)indexCount * indexSize, indexData);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        vertexUsed += vertexCount;
+        indexUsed += indexCount;
+        return offsets;
+    }
+
+private:
+    unsigned int VAO = 0, VBO = 0, EBO = 0;
+    VertexLayout layout;
+    GLenum indexType;
+    size_t indexSize;
+    unsigned int vertexCapacity = 0, vertexUsed = 0;
+    unsigned int indexCapacity = 0, indexUsed = 0;
+
+    // Doubles whichever store is too small and copies the old contents over on the GPU.
+    void grow(unsigned int vertexNeeded, unsigned int indexNeeded)
+    {
+        if (vertexNeeded > vertexCapacity)
+        {
+            while (vertexCapacity < vertexNeeded)
+                vertexCapacity *= 2;
+            VBO = reallocate(VBO, (size_t)vertexUsed * layout.stride, (size_t)vertexCapacity * layout.stride);
+        }
+        if (indexNeeded > indexCapacity)
+        {
+            while (indexCapacity < indexNeeded)
+                indexCapacity *= 2;
+            EBO = reallocate(EBO, (size_t)indexUsed * indexSize, (size_t)indexCapacity * indexSize);
+        }
+        GetGLState().BindVertexArray(VAO);
+        glBindVertexBuffer(GEOMETRY_VERTEX_BINDING, VBO, 0, layout.stride);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        cout << "DEBUG: Geometry arena grown to " << vertexCapacity << " vertices, " << indexCapacity << " indices" << endl;
+    }
+
+    unsigned int reallocate(unsigned int buffer, size_t usedBytes, size_t newBytes)
+    {
+        unsigned int grown;
+        glGenBuffers(1, &grown);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+        glBufferData(GL_COPY_WRITE_BUFFER, newBytes, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        if (usedBytes > 0)
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        return grown;
+    }
+};
+
+// Where a mesh lives inside the pool.
+struct GeometryAllocation
+{
+    GeometryArena* arena = nullptr;
+    int baseVertex = 0;
+    unsigned int firstIndex = 0;
+    unsigned int indexCount = 0;
+};
+
+// Suballocates every mesh from one arena per (vertex format, index type), so whole
+// models can be drawn with a single VAO bind and glMultiDrawElementsIndirect.
+class GeometryPool
+{
+public:
+    GeometryPool()
+    {
+        // bound at the instance binding by plain Draw calls: identity model, palette 0
+        InstanceData identity = { glm::mat4(1.0f), 0, 0.0f, 1.0f, 0.0f };
+        glGenBuffers(1, &defaultInstanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, defaultInstanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData), &identity, GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    GeometryPool(const GeometryPool&) = delete;
+    GeometryPool& operator=(const GeometryPool&) = delete;
+
+    unsigned int GetDefaultInstanceBuffer() const { return defaultInstanceVBO; }
+
+    // vertexData must already be packed for format and indexData stored as indexType.
+    GeometryAllocation Upload(VertexFormat format, const void* vertexData, unsigned int vertexCount, const void* indexData, unsigned int indexCount, GLenum indexType)
+    {
+        GeometryArena& arena = getArena(format, indexType);
+        pair<unsigned int, unsigned int> offsets = arena.Append(vertexData, vertexCount, indexData, indexCount);
+
+        GeometryAllocation allocation;
+        allocation.arena = &arena;
+        allocation.baseVertex = offsets.first;
+        allocation.firstIndex = offsets.second;
+        allocation.indexCount = indexCount;
+        return allocation;
+    }
+
+private:
+    unsigned int defaultInstanceVBO = 0;
+    map<pair<VertexFormat, GLenum>, unique_ptr<GeometryArena>> arenas;
+
+    GeometryArena& getArena(VertexFormat format, GLenum indexType)
+    {
+        unique_ptr<GeometryArena>& arena = arenas[make_pair(format, indexType)];
+        if (!arena)
+            arena.reset(new GeometryArena(GetVertexLayout(format), indexType));
+        return *arena;
+    }
+};
+
+// Created on first use, after the GL context exists, and kept for the life of the process.
+GeometryPool& GetGeometryPool()
+{
+    static GeometryPool* pool = new GeometryPool();
+    return *pool;
+}
+
+// Indirect commands and their per-draw data for one multi-draw submission. Both
+// buffers are orphaned on every Submit, like the instance and palette buffers.
+class MultiDrawBuffer
+{
+public:
+    MultiDrawBuffer()
+    {
+        glGenBuffers(1, &indirectBuffer);
+        glGenBuffers(1, &drawDataBuffer);
+    }
+
+    ~MultiDrawBuffer()
+    {
+        glDeleteBuffers(1, &indirectBuffer);
+        glDeleteBuffers(1, &drawDataBuffer);
+    }
+
+    MultiDrawBuffer(const MultiDrawBuffer&) = delete;
+    MultiDrawBuffer& operator=(const MultiDrawBuffer&) = delete;
+
+    // Leaves the indirect buffer bound and the draw data on DRAW_DATA_BINDING.
+    void Upload(const vector<DrawElementsIndirectCommand>& commands, const vector<DrawData>& draws)
+    {
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+        UploadDrawData(draws);
+    }
+
+    // Draw data only, for commands that live in a buffer written on the GPU.
+    void UploadDrawData(const vector<DrawData>& draws)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawDataBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, draws.size() * sizeof(DrawData), draws.data(), GL_STREAM_DRAW);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer);
+    }
+
+private:
+    unsigned int indirectBuffer = 0;
+    unsigned int drawDataBuffer = 0;
+};
+
+#endif
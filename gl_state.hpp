@@ -0,0 +1,185 @@
+#ifndef GL_STATE_HPP
+#define GL_STATE_HPP
+
+#include <glad/glad.h>
+
+// Shadows the GL state the engine touches every frame and drops calls that would
+// not change it. Everything that binds programs, VAOs, textures or uniform buffers,
+// or toggles blend/depth state, goes through here; code that bypasses it must call
+// Invalidate() afterwards.
+class GLStateCache
+{
+public:
+    static const int MAX_TEXTURE_UNITS = 32;
+    static const int MAX_UNIFORM_BINDINGS = 16;
+
+    GLStateCache()
+    {
+        Invalidate();
+    }
+
+    // Forget everything; the next call of each kind is always issued.
+    void Invalidate()
+    {
+        program = UNKNOWN;
+        vertexArray = UNKNOWN;
+        activeUnit = UNKNOWN;
+        for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+            textures[i] = UNKNOWN;
+        for (int i = 0; i < MAX_UNIFORM_BINDINGS; i++)
+            uniformBuffers[i] = UNKNOWN;
+        blend = depthTest = cullFace = depthMask = -1;
+        blendSrc = blendDst = depthFunc = UNKNOWN;
+    }
+
+    void UseProgram(unsigned int id)
+    {
+        if (count(program == id))
+            return;
+        glUseProgram(id);
+        program = id;
+    }
+
+    void BindVertexArray(unsigned int id)
+    {
+        if (count(vertexArray == id))
+            return;
+        glBindVertexArray(id);
+        vertexArray = id;
+    }
+
+    void ActiveTexture(unsigned int unit)
+    {
+        if (count(activeUnit == unit))
+            return;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        activeUnit = unit;
+    }
+
+    // GL_TEXTURE_2D on the given unit; switches the active unit only if the binding changes.
+    void BindTexture(unsigned int unit, unsigned int id)
+    {
+        if (unit >= MAX_TEXTURE_UNITS)
+        {
+            ActiveTexture(unit);
+            glBindTexture(GL_TEXTURE_2D, id);
+            return;
+        }
+        if (count(textures[unit] == id))
+            return;
+        ActiveTexture(unit);
+        glBindTexture(GL_TEXTURE_2D, id);
+        textures[unit] = id;
+    }
+
+    // Call before glDeleteTextures so a recycled name isn't mistaken for a live binding.
+    void ForgetTexture(unsigned int id)
+    {
+        for (int i = 0; i < MAX_TEXTURE_UNITS; i++)
+        {
+            if (textures[i] == id)
+                textures[i] = UNKNOWN;
+        }
+    }
+
+    // Whole-buffer glBindBufferBase on GL_UNIFORM_BUFFER.
+    void BindUniformBuffer(unsigned int index, unsigned int id)
+    {
+        if (index >= MAX_UNIFORM_BINDINGS)
+        {
+            glBindBufferBase(GL_UNIFORM_BUFFER, index, id);
+            return;
+        }
+        if (count(uniformBuffers[index] == id))
+            return;
+        glBindBufferBase(GL_UNIFORM_BUFFER, index, id);
+        uniformBuffers[index] = id;
+    }
+
+    // Call before glDeleteBuffers on a buffer bound through BindUniformBuffer.
+    void ForgetBuffer(unsigned int id)
+    {
+        for (int i = 0; i < MAX_UNIFORM_BINDINGS; i++)
+        {
+            if (uniformBuffers[i] == id)
+                uniformBuffers[i] = UNKNOWN;
+        }
+    }
+
+    void SetBlend(bool enabled) { setCapability(GL_BLEND, blend, enabled); }
+    void SetDepthTest(bool enabled) { setCapability(GL_DEPTH_TEST, depthTest, enabled); }
+    void SetCullFace(bool enabled) { setCapability(GL_CULL_FACE, cullFace, enabled); }
+
+    void BlendFunc(GLenum src, GLenum dst)
+    {
+        if (count(blendSrc == src && blendDst == dst))
+            return;
+        glBlendFunc(src, dst);
+        blendSrc = src;
+        blendDst = dst;
+    }
+
+    void DepthFunc(GLenum func)
+    {
+        if (count(depthFunc == func))
+            return;
+        glDepthFunc(func);
+        depthFunc = func;
+    }
+
+    void DepthMask(bool enabled)
+    {
+        if (count(depthMask == (int)enabled))
+            return;
+        glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+        depthMask = enabled;
+    }
+
+    unsigned int GetIssued() const { return issued; }
+    unsigned int GetDropped() const { return dropped; }
+    void ResetCounters()
+    {
+        issued = 0;
+        dropped = 0;
+    }
+
+private:
+    static const unsigned int UNKNOWN = 0xffffffffu;
+
+    unsigned int program, vertexArray, activeUnit;
+    unsigned int textures[MAX_TEXTURE_UNITS];
+    unsigned int uniformBuffers[MAX_UNIFORM_BINDINGS];
+    int blend, depthTest, cullFace, depthMask;
+    GLenum blendSrc, blendDst, depthFunc;
+    unsigned int issued = 0;
+    unsigned int dropped = 0;
+
+    // Counts the call and returns whether it is redundant.
+    bool count(bool redundant)
+    {
+        if (redundant)
+            dropped++;
+        else
+            issued++;
+        return redundant;
+    }
+
+    void setCapability(GLenum cap, int& current, bool enabled)
+    {
+        if (count(current == (int)enabled))
+            return;
+        if (enabled)
+            glEnable(cap);
+        else
+            glDisable(cap);
+        current = enabled;
+    }
+};
+
+inline GLStateCache& GetGLState()
+{
+    static GLStateCache state;
+    return state;
+}
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef GPU_CULLING_HPP
+#define GPU_CULLING_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <shader.hpp>
+#include <gl_state.hpp>
+#include <geometry_pool.hpp>
+#include <bounds.hpp>
+#include <frustum.hpp>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// Shader storage bindings of instance_cull.comp; 0 and 1 are the bone palettes and draw data.
+#define CULL_SOURCE_BINDING 2
+#define CULL_VISIBLE_BINDING 3
+#define CULL_COMMAND_BINDING 4
+// Texture unit for the depth copy while building and the pyramid while culling
+#define HIZ_TEXTURE_UNIT 9
+
+// Hierarchical depth: the frame's depth buffer copied into level 0 of an R32F texture,
+// then each level holding the farthest depth of the 2x2 (3x3 at odd edges) texels
+// below it. Build at the end of a frame; InstanceCuller tests against it the next one,
+// together with the viewProjection it was rendered with.
+class HiZPyramid
+{
+public:
+    HiZPyramid() : downsampleShader("hiz_downsample.comp")
+    {
+        depthTextureUniform = downsampleShader.GetUniform<int>("depthTexture");
+        levelUniform = downsampleShader.GetUniform<int>("level");
+        sourceSizeUniform = downsampleShader.GetUniform<glm::ivec2>("sourceSize");
+    }
+
+    ~HiZPyramid()
+    {
+        release();
+    }
+
+    HiZPyramid(const HiZPyramid&) = delete;
+    HiZPyramid& operator=(const HiZPyramid&) = delete;
+
+    // Reads the depth of the bound read framebuffer (width x height from the origin).
+    void Build(int width, int height, const glm::mat4& viewProjection)
+    {
+        if (width <= 0 || height <= 0)
+        {
+            valid = false;
+            return;
+        }
+        if (width != this->width || height != this->height)
+            allocate(width, height);
+
+        GLStateCache& glState = GetGLState();
+        glState.BindTexture(HIZ_TEXTURE_UNIT, depthCopy);
+        glState.ActiveTexture(HIZ_TEXTURE_UNIT);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, width, height);
+
+        downsampleShader.use();
+        downsampleShader.setInt(depthTextureUniform, HIZ_TEXTURE_UNIT);
+        int levelWidth = width, levelHeight = height;
+        for (int level = 0; level < levels; level++)
+        {
+            int sourceWidth = levelWidth, sourceHeight = levelHeight;
+            if (level > 0)
+            {
+                levelWidth = max(levelWidth / 2, 1);
+                levelHeight = max(levelHeight / 2, 1);
+            }
+            glBindImageTexture(0, pyramid, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+            glBindImageTexture(1, pyramid, max(level - 1, 0), GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+            downsampleShader.setInt(levelUniform, level);
+            glUniform2i(sourceSizeUniform.location, sourceWidth, sourceHeight);
+            glDispatchCompute((levelWidth + 7) / 8, (levelHeight + 7) / 8, 1);
+            glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+        }
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+        this->viewProjection = viewProjection;
+        valid = true;
+    }
+
+    // Forget the last build, e.g. after a camera cut
+    void Invalidate() { valid = false; }
+
+    bool IsValid() const { return valid; }
+    unsigned int GetTexture() const { return pyramid; }
+    int GetWidth() const { return width; }
+    int GetHeight() const { return height; }
+    int GetLevelCount() const { return levels; }
+    const glm::mat4& GetViewProjection() const { return viewProjection; }
+
+private:
+    Shader downsampleShader;
+    Uniform<int> depthTextureUniform, levelUniform;
+    Uniform<glm::ivec2> sourceSizeUniform;
+    unsigned int depthCopy = 0;
+    unsigned int pyramid = 0;
+    int width = 0, height = 0, levels = 0;
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    bool valid = false;
+
+    void allocate(int width, int height)
+    {
+        release();
+        this->width = width;
+        this->height = height;
+        levels = 1;
+        while ((max(width, height) >> levels) > 0)
+            levels++;
+
+        glGenTextures(1, &depthCopy);
+        GetGLState().BindTexture(HIZ_TEXTURE_UNIT, depthCopy);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        glGenTextures(1, &pyramid);
+        GetGLState().BindTexture(HIZ_TEXTURE_UNIT, pyramid);
+        glTexStorage2D(GL_TEXTURE_2D, levels, GL_R32F, width, height);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        valid = false;
+        cout << "DEBUG: Hi-Z pyramid " << width << "x" << height << ", " << levels << " levels" << endl;
+    }
+
+    void release()
+    {
+        for (unsigned int* texture : { &depthCopy, &pyramid })
+        {
+            if (*texture == 0)
+                continue;
+            GetGLState().ForgetTexture(*texture);
+            glDeleteTextures(1, texture);
+            *texture = 0;
+        }
+    }
+};
+
+// GPU-driven culling for large instanced crowds. The instances are uploaded once; each
+// frame a compute pass (instance_cull.comp) moves them by a shared transform, tests
+// their boxes against the frustum and the previous frame's Hi-Z pyramid, and appends
+// the survivors to a buffer that is drawn through indirect commands whose instance
+// counts the same pass wrote. Nothing per instance comes back to the CPU.
+class InstanceCuller
+{
+public:
+    InstanceCuller() : cullShader("instance_cull.comp")
+    {
+        uniforms.instanceCount = cullShader.GetUniform<int>("instanceCount");
+        uniforms.commandCount = cullShader.GetUniform<int>("commandCount");
+        uniforms.transform = cullShader.GetUniform<glm::mat4>("transform");
+        uniforms.boundsMin = cullShader.GetUniform<glm::vec3>("boundsMin");
+        uniforms.boundsMax = cullShader.GetUniform<glm::vec3>("boundsMax");
+        uniforms.frustumPlanes = cullShader.GetUniform<glm::vec4>("frustumPlanes");
+        uniforms.useHiZ = cullShader.GetUniform<bool>("useHiZ");
+        uniforms.hiZ = cullShader.GetUniform<int>("hiZ");
+        uniforms.hiZViewProjection = cullShader.GetUniform<glm::mat4>("hiZViewProjection");
+        uniforms.hiZSize = cullShader.GetUniform<glm::ivec2>("hiZSize");
+        uniforms.hiZLevels = cullShader.GetUniform<int>("hiZLevels");
+
+        glGenBuffers(1, &sourceBuffer);
+        glGenBuffers(1, &visibleBuffer);
+        glGenBuffers(1, &commandBuffer);
+    }
+
+    ~InstanceCuller()
+    {
+        glDeleteBuffers(1, &sourceBuffer);
+        glDeleteBuffers(1, &visibleBuffer);
+        glDeleteBuffers(1, &commandBuffer);
+    }
+
+    InstanceCuller(const InstanceCuller&) = delete;
+    InstanceCuller& operator=(const InstanceCuller&) = delete;
+
+    // Model matrices are relative to the transform later passed to Cull.
+    void SetInstances(const vector<InstanceData>& instances)
+    {
+        instanceCount = instances.size();
+        size_t size = max(instances.size(), (size_t)1) * sizeof(InstanceData);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, sourceBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, instances.empty() ? NULL : instances.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, size, NULL, GL_DYNAMIC_COPY);
+    }
+
+    // Per-mesh commands with instanceCount 0, normally Model::GetIndirectCommands.
+    void SetCommands(const vector<DrawElementsIndirectCommand>& commands)
+    {
+        this->commands = commands;
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, max(commands.size(), (size_t)1) * sizeof(DrawElementsIndirectCommand), commands.empty() ? NULL : commands.data(), GL_DYNAMIC_COPY);
+    }
+
+    // bounds are the model-space bounds shared by every instance. The Hi-Z test is
+    // skipped until hiZ has been built once.
+    void Cull(const glm::mat4& transform, const Bounds& bounds, const Frustum& frustum, const HiZPyramid& hiZ)
+    {
+        if (instanceCount == 0 || commands.empty())
+            return;
+
+        // reset the instance counts
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+
+        cullShader.use();
+        cullShader.setInt(uniforms.instanceCount, instanceCount);
+        cullShader.setInt(uniforms.commandCount, commands.size());
+        cullShader.setMat4(uniforms.transform, transform);
+        cullShader.setVec3(uniforms.boundsMin, bounds.min);
+        cullShader.setVec3(uniforms.boundsMax, bounds.max);
+        glUniform4fv(uniforms.frustumPlanes.location, 6, &frustum.planes[0][0]);
+        cullShader.setBool(uniforms.useHiZ, hiZ.IsValid());
+        if (hiZ.IsValid())
+        {
+            GetGLState().BindTexture(HIZ_TEXTURE_UNIT, hiZ.GetTexture());
+            cullShader.setInt(uniforms.hiZ, HIZ_TEXTURE_UNIT);
+            cullShader.setMat4(uniforms.hiZViewProjection, hiZ.GetViewProjection());
+            glUniform2i(uniforms.hiZSize.location, hiZ.GetWidth(), hiZ.GetHeight());
+            cullShader.setInt(uniforms.hiZLevels, hiZ.GetLevelCount());
+        }
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_SOURCE_BINDING, sourceBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_VISIBLE_BINDING, visibleBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CULL_COMMAND_BINDING, commandBuffer);
+        glDispatchCompute((instanceCount + 63) / 64, 1, 1);
+        // the buffer-update bit covers the next reset and ReadVisibleCount seeing the atomics
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    }
+
+    unsigned int GetVisibleBuffer() const { return visibleBuffer; }
+    unsigned int GetCommandBuffer() const { return commandBuffer; }
+    unsigned int GetInstanceCount() const { return instanceCount; }
+
+    // Waits for the last Cull to finish; meant for occasional stats, not every frame.
+    unsigned int ReadVisibleCount() const
+    {
+        if (commands.empty())
+            return 0;
+        DrawElementsIndirectCommand command;
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, sizeof(command), &command);
+        return command.instanceCount;
+    }
+
+private:
+    Shader cullShader;
+    // instance_cull.comp's uniforms, resolved once
+    struct
+    {
+        Uniform<int> instanceCount, commandCount, hiZ, hiZLevels;
+        Uniform<glm::mat4> transform, hiZViewProjection;
+        Uniform<glm::vec3> boundsMin, boundsMax;
+        Uniform<glm::vec4> frustumPlanes;
+        Uniform<bool> useHiZ;
+        Uniform<glm::ivec2> hiZSize;
+    } uniforms;
+    unsigned int sourceBuffer = 0;
+    unsigned int visibleBuffer = 0;
+    unsigned int commandBuffer = 0;
+    unsigned int instanceCount = 0;
+    vector<DrawElementsIndirectCommand> commands;
+};
+
+#endif
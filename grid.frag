@@ -2,11 +2,20 @@
 out vec4 FragColor;
 
 in vec3 FragPos;
-uniform vec3 viewPos;
+
+// Shared per-frame camera and light state (FrameUniforms)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
 
 void main()
 {
-    float distance = length(FragPos - viewPos);
+    float distance = length(FragPos - viewPos.xyz);
     float alpha = 1.0 - smoothstep(20.0, 100.0, distance);
     
     if (alpha <= 0.0)
@@ -4,8 +4,16 @@ layout (location = 0) in vec3 aPos;
 out vec3 FragPos;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+
+// Shared per-frame camera and light state (FrameUniforms)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
 
 void main()
 {
@@ -4,6 +4,8 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <cmath>
+#include <algorithm>
+#include <unordered_map>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -11,6 +13,16 @@
 #include "shader.hpp"
 #include "camera.hpp"
 #include "model.hpp"
+#include "asset_loader.hpp"
+#include "scene_bvh.hpp"
+#include "occlusion_culler.hpp"
+#include "gpu_culling.hpp"
+#include "bvh_benchmark.hpp"
+#include "pose_cache.hpp"
+#include "vat.hpp"
+#include "bone_palette.hpp"
+#include "frame_uniforms.hpp"
+#include "gl_state.hpp"
 
 Camera camera(glm::vec3(0.0f, 0.5f, 5.0f));
 float lastX = 400, lastY = 300;
@@ -71,8 +83,16 @@ void processInput(GLFWwindow* window)
         camera.ProcessKeyboard(RIGHT, deltaTime * speedMult);
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    // ./main --bench-bvh [objects]: time scene index queries against brute force and exit
+    if (argc > 1 && string(argv[1]) == "--bench-bvh")
+        return RunBVHBenchmark(argc > 2 ? atoi(argv[2]) : 100000);
+    // ./main --gpu-army [troopers]: replace the 21x21 army with a large one culled on the GPU
+    int gpuArmyCount = 0;
+    if (argc > 1 && string(argv[1]) == "--gpu-army")
+        gpuArmyCount = max(argc > 2 ? atoi(argv[2]) : 50000, 1);
+
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
@@ -98,9 +118,10 @@ int main()
         return -1;
     }
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    GLStateCache& glState = GetGLState();
+    glState.SetDepthTest(true);
+    glState.SetBlend(true);
+    glState.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     Shader ourShader("shader.vert", "shader.frag");
     Shader planetShader("planet.vert", "planet.frag");
@@ -108,6 +129,16 @@ int main()
     Shader gridShader("grid.vert", "grid.frag");
     Shader enigmaShader("enigma.vert", "enigma.frag");
     Shader hudShader("hud.vert", "hud.frag");
+    Shader crowdShader("crowd.vert", "shader.frag");
+    Shader placeholderShader("placeholder.vert", "placeholder.frag");
+    // GPU-driven army: culled against the frustum and last frame's Hi-Z, drawn indirectly
+    unique_ptr<HiZPyramid> hiZ;
+    unique_ptr<InstanceCuller> gpuArmy;
+    if (gpuArmyCount > 0) {
+        hiZ.reset(new HiZPyramid());
+        gpuArmy.reset(new InstanceCuller());
+    }
+    FrameUniforms frameUniforms;
 
     // HUD Setup
     float hudVertices[] = {
@@ -121,7 +152,7 @@ int main()
     unsigned int hudVAO, hudVBO;
     glGenVertexArrays(1, &hudVAO);
     glGenBuffers(1, &hudVBO);
-    glBindVertexArray(hudVAO);
+    glState.BindVertexArray(hudVAO);
     glBindBuffer(GL_ARRAY_BUFFER, hudVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(hudVertices), hudVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -132,27 +163,83 @@ int main()
 
     // Audio Setup
     ma_engine engine;
-    ma_sound bgMusic;
-    bool audioLoaded = false;
-    
-    if (ma_engine_init(NULL, &engine) == MA_SUCCESS) {
+    bool engineReady = ma_engine_init(NULL, &engine) == MA_SUCCESS;
+    AssetHandle<ma_sound> bgMusic;
+    if (engineReady) {
         // You can change this path to your audio file
         std::string audioPath = "/home/chiranjeet/Graphics/model_files/march-of-the-troopers-star-wars-style-cinematic-music-207056.mp3";
-        if (ma_sound_init_from_file(&engine, audioPath.c_str(), 0, NULL, NULL, &bgMusic) == MA_SUCCESS) {
-            ma_sound_set_looping(&bgMusic, MA_TRUE);
-            ma_sound_start(&bgMusic);
-            audioLoaded = true;
-        }
+        // Opened on a worker; starts playing once the main thread picks it up
+        bgMusic = AssetLoader::Get().Load<unique_ptr<ma_sound>, ma_sound>(audioPath,
+            [&engine, audioPath](unique_ptr<ma_sound>& sound) {
+                sound.reset(new ma_sound());
+                return ma_sound_init_from_file(&engine, audioPath.c_str(), 0, NULL, NULL, sound.get()) == MA_SUCCESS;
+            },
+            [](unique_ptr<ma_sound>& sound, bool loaded) {
+                if (!loaded)
+                    return unique_ptr<ma_sound>();
+                ma_sound_set_looping(sound.get(), MA_TRUE);
+                ma_sound_start(sound.get());
+                return move(sound);
+            });
     }
 
-    // Load models
-    Model ourModel("/home/chiranjeet/Graphics/model_files/ue4-storm-trooper-rigged-game-ready/source/Walking.fbx");
-    Model planetModel("/home/chiranjeet/Graphics/model_files/wskrs-the-eyes-and-ears-of-seaquest/source/WSKRS.fbx");
-    Model enigmaModel("/home/chiranjeet/Graphics/model_files/star-cruiser-x-enigma/scene.gltf");
-
-    // Animation variables
-    Assimp::Importer animationImporter;
-    const aiScene* animationScene = animationImporter.ReadFile("/home/chiranjeet/Graphics/model_files/ue4-storm-trooper-rigged-game-ready/source/Walking.fbx", aiProcess_Triangulate);
+    // Load models in the background; the render loop draws placeholders until each one is uploaded
+    AssetHandle<Model> trooperAsset = AssetLoader::Get().LoadModel("/home/chiranjeet/Graphics/model_files/ue4-storm-trooper-rigged-game-ready/source/Walking.fbx");
+    AssetHandle<Model> planetAsset = AssetLoader::Get().LoadModel("/home/chiranjeet/Graphics/model_files/wskrs-the-eyes-and-ears-of-seaquest/source/WSKRS.fbx");
+    AssetHandle<Model> enigmaAsset = AssetLoader::Get().LoadModel("/home/chiranjeet/Graphics/model_files/star-cruiser-x-enigma/scene.gltf");
+    bool trooperSetUp = false;
+    bool assetsReported = false;
+
+    // Per-trooper walk variety: a fixed phase offset and playback speed for each of the 21x21 army
+    PoseCache poseCache;
+    unique_ptr<BonePaletteBuffer> bonePalettes;
+    unordered_map<const vector<glm::mat4>*, int> posePalettes;
+    InstanceBuffer trooperInstanceBuffer;
+    vector<InstanceData> armyInstances;
+    vector<uint8_t> trooperVisible;
+    vector<uint8_t> trooperNear;
+
+    // Every object in the world, for culling and proximity queries; moving ones are refitted per frame
+    SceneBVH sceneIndex;
+    vector<int> trooperIds;
+    vector<int> objectTrooper; // scene id -> trooper index, -1 for other objects
+    int planetId = -1, enigmaId = -1;
+    vector<int> sceneHits;
+    CullStats frameCull, lastCull;
+    // The planet and the Enigma hide whatever troopers are behind them
+    OcclusionCuller occlusion;
+    vector<InstanceData> trooperInstances;
+    vector<InstanceData> crowdInstances;
+    const float crowdDistance = 25.0f; // beyond this troopers animate from the baked bone texture
+    BakedAnimation bakedWalk;
+    vector<float> trooperPhase(21 * 21, 0.0f);
+    vector<float> trooperSpeed(21 * 21, 1.0f);
+
+    // Wireframe unit cube drawn in place of models that are still loading
+    float placeholderVertices[] = {
+        -0.5f, -0.5f, -0.5f,   0.5f, -0.5f, -0.5f,    0.5f, -0.5f, -0.5f,   0.5f, -0.5f,  0.5f,
+         0.5f, -0.5f,  0.5f,  -0.5f, -0.5f,  0.5f,   -0.5f, -0.5f,  0.5f,  -0.5f, -0.5f, -0.5f,
+        -0.5f,  0.5f, -0.5f,   0.5f,  0.5f, -0.5f,    0.5f,  0.5f, -0.5f,   0.5f,  0.5f,  0.5f,
+         0.5f,  0.5f,  0.5f,  -0.5f,  0.5f,  0.5f,   -0.5f,  0.5f,  0.5f,  -0.5f,  0.5f, -0.5f,
+        -0.5f, -0.5f, -0.5f,  -0.5f,  0.5f, -0.5f,    0.5f, -0.5f, -0.5f,   0.5f,  0.5f, -0.5f,
+         0.5f, -0.5f,  0.5f,   0.5f,  0.5f,  0.5f,   -0.5f, -0.5f,  0.5f,  -0.5f,  0.5f,  0.5f
+    };
+    unsigned int placeholderVAO, placeholderVBO;
+    glGenVertexArrays(1, &placeholderVAO);
+    glGenBuffers(1, &placeholderVBO);
+    glState.BindVertexArray(placeholderVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, placeholderVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(placeholderVertices), placeholderVertices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    auto drawPlaceholder = [&](const glm::mat4& transform, const glm::vec3& color, float time) {
+        placeholderShader.use();
+        placeholderShader.setMat4("model", transform);
+        placeholderShader.setVec3("color", color);
+        placeholderShader.setFloat("time", time);
+        glState.BindVertexArray(placeholderVAO);
+        glDrawArrays(GL_LINES, 0, 24);
+    };
 
     // Unified Uniform Grid (Vast and consistent)
     vector<float> gridVertices;
@@ -168,7 +255,7 @@ int main()
     unsigned int gridVAO, gridVBO;
     glGenVertexArrays(1, &gridVAO);
     glGenBuffers(1, &gridVBO);
-    glBindVertexArray(gridVAO);
+    glState.BindVertexArray(gridVAO);
     glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
     glBufferData(GL_ARRAY_BUFFER, gridVertices.size() * sizeof(float), &gridVertices[0], GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -192,7 +279,7 @@ int main()
     unsigned int skyboxVAO, skyboxVBO;
     glGenVertexArrays(1, &skyboxVAO);
     glGenBuffers(1, &skyboxVBO);
-    glBindVertexArray(skyboxVAO);
+    glState.BindVertexArray(skyboxVAO);
     glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
     glEnableVertexAttribArray(0);
@@ -206,6 +293,69 @@ int main()
 
         processInput(window);
 
+        // Finish whatever the workers loaded since last frame
+        AssetLoader::Get().Pump();
+        static bool firstFrame = true;
+        if (firstFrame) {
+            cout << "DEBUG: First frame " << currentFrame * 1000.0f << " ms after startup, " << AssetLoader::Get().GetPendingCount() << " asset(s) still loading" << endl;
+            firstFrame = false;
+        }
+        if (!assetsReported && AssetLoader::Get().GetPendingCount() == 0 && TextureCache::Get().GetPendingCount() == 0) {
+            cout << "DEBUG: All assets loaded " << currentFrame * 1000.0f << " ms after startup" << endl;
+            cout << "DEBUG: Texture cache holds " << TextureCache::Get().GetTextureCount() << " textures (" << TextureCache::Get().GetHits() << " reused, " << TextureCache::Get().GetMisses() << " loaded)" << endl;
+            assetsReported = true;
+        }
+
+        // Trooper resources sized from the model, created the frame it arrives
+        if (!trooperSetUp && trooperAsset.IsReady()) {
+            Model& ourModel = *trooperAsset;
+            bonePalettes.reset(new BonePaletteBuffer(max(ourModel.GetBoneCount(), 1)));
+            if (ourModel.HasAnimations())
+            {
+                float clipSeconds = ourModel.GetAnimation(0).GetDurationSeconds();
+                for (unsigned int i = 0; i < trooperPhase.size(); i++)
+                {
+                    unsigned int seed = i * 2654435761u;
+                    trooperPhase[i] = (float)((seed >> 8) & 255) / 255.0f * clipSeconds;
+                    trooperSpeed[i] = 0.9f + 0.2f * (float)((seed >> 16) & 255) / 255.0f;
+                }
+                bakedWalk = BakeAnimationTexture(ourModel, 0);
+            }
+            if (gpuArmy)
+            {
+                // Square block ahead of the camera, uploaded once; Cull moves it with the world
+                float clipSeconds = ourModel.HasAnimations() ? ourModel.GetAnimation(0).GetDurationSeconds() : 1.0f;
+                int side = (int)ceil(sqrt((double)gpuArmyCount));
+                vector<InstanceData> army;
+                army.reserve(gpuArmyCount);
+                for (int i = 0; i < gpuArmyCount; i++)
+                {
+                    glm::mat4 trooperModel = glm::translate(glm::mat4(1.0f), glm::vec3(((float)(i % side) - side * 0.5f) * 2.0f, 0.0f, 20.0f - (float)(i / side) * 2.0f));
+                    trooperModel = glm::rotate(trooperModel, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+                    trooperModel = glm::scale(trooperModel, glm::vec3(0.02f, 0.02f, 0.02f));
+                    unsigned int seed = i * 2654435761u;
+                    InstanceData instance;
+                    instance.model = trooperModel;
+                    instance.paletteIndex = 0;
+                    instance.phase = (float)((seed >> 8) & 255) / 255.0f * clipSeconds;
+                    instance.speed = 0.9f + 0.2f * (float)((seed >> 16) & 255) / 255.0f;
+                    instance.padding = 0.0f;
+                    army.push_back(instance);
+                }
+                gpuArmy->SetInstances(army);
+                gpuArmy->SetCommands(ourModel.GetIndirectCommands());
+                cout << "DEBUG: GPU army of " << gpuArmyCount << " troopers (" << side << " x " << side << ")" << endl;
+            }
+            for (int t = 0; t < 21 * 21 && !gpuArmy; t++)
+            {
+                int id = sceneIndex.Insert(ourModel.GetBounds());
+                trooperIds.push_back(id);
+                objectTrooper.resize(max((int)objectTrooper.size(), id + 1), -1);
+                objectTrooper[id] = t;
+            }
+            trooperSetUp = true;
+        }
+
         // FPS Calculation
         static int frameCount = 0;
         static float lastTime = 0.0f;
@@ -215,6 +365,12 @@ int main()
             fps = frameCount;
             frameCount = 0;
             lastTime = currentFrame;
+            cout << "DEBUG: GL state cache issued " << glState.GetIssued() << " calls, dropped " << glState.GetDropped() << " redundant ones in " << fps << " frames" << endl;
+            glState.ResetCounters();
+            cout << "DEBUG: Frustum culling last frame: " << lastCull.visible << " visible, " << lastCull.culled << " culled, " << lastCull.occluded << " occluded (meshes and troopers)" << endl;
+            cout << "DEBUG: Occlusion buffer: " << occlusion.GetTriangleCount() << " occluder triangles rasterized in " << occlusion.GetRasterizeMs() << " ms" << endl;
+            if (gpuArmy && trooperSetUp)
+                cout << "DEBUG: GPU culling kept " << gpuArmy->ReadVisibleCount() << " of " << gpuArmy->GetInstanceCount() << " troopers" << endl;
         }
 
         // Auto-move camera with the army
@@ -231,10 +387,15 @@ int main()
         // Light Settings
         glm::vec3 lightPos(0.0f, 150.0f, camera.position.z - 200.0f);
         glm::vec3 lightColor(1.0f, 1.0f, 1.0f);
+        frameUniforms.Update(projection, view, camera.position, lightPos, lightColor);
+        glm::mat4 viewProjection = projection * view;
+        Frustum frustum = camera.GetFrustum(projection);
+        frameCull = CullStats();
+        occlusion.Begin(viewProjection);
 
         // 1. Draw Skybox (Procedural)
-        glDisable(GL_BLEND);
-        glDepthFunc(GL_LEQUAL);
+        glState.SetBlend(false);
+        glState.DepthFunc(GL_LEQUAL);
         skyShader.use();
         
         glm::mat4 skyView = glm::mat4(glm::mat3(view));
@@ -255,16 +416,11 @@ int main()
         skyShader.setVec3("lightDirection", sunDir);
         skyShader.setFloat("time", currentFrame);
 
-        glBindVertexArray(skyboxVAO);
+        glState.BindVertexArray(skyboxVAO);
         glDrawArrays(GL_TRIANGLES, 0, 36);
-        glDepthFunc(GL_LESS);
+        glState.DepthFunc(GL_LESS);
 
         planetShader.use();
-        planetShader.setMat4("projection", projection);
-        planetShader.setMat4("view", view);
-        planetShader.setVec3("lightPos", lightPos);
-        planetShader.setVec3("viewPos", camera.position);
-        planetShader.setVec3("lightColor", lightColor);
         glm::mat4 model = glm::mat4(1.0f);
         // Position it relative to the camera to ensure it's never passed
         model = glm::translate(model, glm::vec3(-160.0f, 161.0f, camera.position.z - 400.0f)); 
@@ -276,15 +432,20 @@ int main()
         
         model = glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f)); // Smaller scale
         planetShader.setMat4("model", model);
-        planetModel.Draw(planetShader);
+        if (planetAsset.IsReady())
+        {
+            Bounds planetBounds = TransformBounds(planetAsset->GetBounds(), model);
+            if (planetId < 0)
+                planetId = sceneIndex.Insert(planetBounds);
+            sceneIndex.Update(planetId, planetBounds);
+            frameCull.Add(planetAsset->DrawCulled(planetShader, ExtractFrustum(viewProjection * model)));
+            occlusion.AddOccluder(planetAsset->GetOccluder(), model);
+        }
+        else
+            drawPlaceholder(glm::scale(model, glm::vec3(40.0f)), glm::vec3(0.2f, 0.6f, 1.0f), currentFrame);
 
         // 3. Draw Star Cruiser Enigma (Opaque - Always in front)
         enigmaShader.use();
-        enigmaShader.setMat4("projection", projection);
-        enigmaShader.setMat4("view", view);
-        enigmaShader.setVec3("lightPos", lightPos);
-        enigmaShader.setVec3("viewPos", camera.position);
-        enigmaShader.setVec3("lightColor", lightColor);
         
         // Hovering Effect (Vertical Oscillation)
         float hoverOffset = (float)sin(glfwGetTime() * 1.0f) * 5.0f;
@@ -299,15 +460,25 @@ int main()
         enigmaM = glm::rotate(enigmaM, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
         enigmaM = glm::scale(enigmaM, glm::vec3(1010.0f, 1010.0f, 1010.0f)); 
         enigmaShader.setMat4("model", enigmaM);
-        enigmaModel.Draw(enigmaShader);
+        if (enigmaAsset.IsReady())
+        {
+            Bounds enigmaBounds = TransformBounds(enigmaAsset->GetBounds(), enigmaM);
+            if (enigmaId < 0)
+                enigmaId = sceneIndex.Insert(enigmaBounds);
+            sceneIndex.Update(enigmaId, enigmaBounds);
+            frameCull.Add(enigmaAsset->DrawCulled(enigmaShader, ExtractFrustum(viewProjection * enigmaM)));
+            occlusion.AddOccluder(enigmaAsset->GetOccluder(), enigmaM);
+        }
+        else
+            drawPlaceholder(glm::scale(enigmaM, glm::vec3(0.1f)), glm::vec3(1.0f, 0.6f, 0.2f), currentFrame);
+
+        // Occluders are all in; troopers are tested against this before they are submitted
+        occlusion.Rasterize();
 
         // 4. Draw Green Wireframe Grid (Blending ON)
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glState.SetBlend(true);
+        glState.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
         gridShader.use();
-        gridShader.setMat4("projection", projection);
-        gridShader.setMat4("view", view);
-        gridShader.setVec3("viewPos", camera.position);
         
         glm::mat4 gridModel = glm::mat4(1.0f);
         float snap = 5.0f; 
@@ -316,59 +487,176 @@ int main()
         gridModel = glm::translate(gridModel, glm::vec3(gridX, 0.0f, gridZ)); 
         
         gridShader.setMat4("model", gridModel);
-        glBindVertexArray(gridVAO);
+        glState.BindVertexArray(gridVAO);
         glDrawArrays(GL_LINES, 0, gridVertices.size() / 3);
-        glDisable(GL_BLEND);
+        glState.SetBlend(false);
 
         // 4. Draw Troopers (Opaque)
-        ourShader.use();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-        ourShader.setVec3("lightPos", lightPos);
-        ourShader.setVec3("viewPos", camera.position);
-        ourShader.setVec3("lightColor", lightColor);
-
-        if (animationScene && animationScene->mNumAnimations > 0)
+        float worldOffset = currentFrame * 2.0f; // Matches camera auto-speed
+        if (!trooperSetUp)
         {
-            vector<glm::mat4> transforms(100, glm::mat4(1.0f));
-            ourModel.UpdateAnimation(currentFrame, animationScene, transforms);
-            for (int i = 0; i < transforms.size(); i++)
-                ourShader.setMat4("finalBonesMatrices[" + to_string(i) + "]", transforms[i]);
-            ourShader.setBool("hasTexture", true);
+            // One box per trooper until the model is uploaded
+            for (int x = -10; x <= 10; x++)
+            {
+                for (int z = -10; z <= 10; z++)
+                {
+                    glm::mat4 box = glm::translate(glm::mat4(1.0f), glm::vec3((float)x * 2.0f, 0.9f, (float)z * 2.0f - worldOffset));
+                    drawPlaceholder(glm::scale(box, glm::vec3(0.5f, 1.8f, 0.5f)), glm::vec3(0.8f), currentFrame);
+                }
+            }
         }
-
-        // Render army of tiny troopers (Moving with the world)
-        float worldOffset = currentFrame * 2.0f; // Matches camera auto-speed
-        for (int x = -10; x <= 10; x++)
+        else if (gpuArmy)
+        {
+            // The compute pass decides visibility and instance counts; everything is posed from the baked texture
+            glm::mat4 armyTransform = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -worldOffset));
+            gpuArmy->Cull(armyTransform, trooperAsset->GetBounds(), frustum, *hiZ);
+            crowdShader.use();
+            crowdShader.setFloat("time", currentFrame);
+            crowdShader.setInt("boneCount", bakedWalk.boneCount);
+            crowdShader.setInt("boneFrameCount", max(bakedWalk.frameCount, 1));
+            crowdShader.setFloat("boneFramesPerSecond", bakedWalk.framesPerSecond);
+            crowdShader.setInt("boneTexture", 8);
+            glState.BindTexture(8, bakedWalk.texture);
+            trooperAsset->DrawIndirect(crowdShader, gpuArmy->GetVisibleBuffer(), gpuArmy->GetCommandBuffer());
+        }
+        else
         {
-            for (int z = -10; z <= 10; z++)
+            Model& ourModel = *trooperAsset;
+            if (ourModel.HasAnimations())
+                poseCache.BeginFrame();
+
+            // Render army of tiny troopers (Moving with the world)
+            bonePalettes->Begin();
+            posePalettes.clear();
+            trooperInstances.clear();
+            crowdInstances.clear();
+            armyInstances.clear();
+            const Bounds& trooperBounds = ourModel.GetBounds();
+            for (int x = -10; x <= 10; x++)
+            {
+                for (int z = -10; z <= 10; z++)
+                {
+                    glm::mat4 trooperModel = glm::mat4(1.0f);
+                    // Translate relative to a moving base to keep up with camera
+                    trooperModel = glm::translate(trooperModel, glm::vec3((float)x * 2.0f, 0.0f, (float)z * 2.0f - worldOffset));
+                    trooperModel = glm::rotate(trooperModel, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f)); 
+                    trooperModel = glm::scale(trooperModel, glm::vec3(0.02f, 0.02f, 0.02f)); 
+
+                    int trooper = (x + 10) * 21 + (z + 10);
+                    InstanceData instance;
+                    instance.model = trooperModel;
+                    instance.paletteIndex = 0;
+                    instance.phase = trooperPhase[trooper];
+                    instance.speed = trooperSpeed[trooper];
+                    instance.padding = 0.0f;
+                    sceneIndex.Update(trooperIds[armyInstances.size()], TransformBounds(trooperBounds, trooperModel));
+                    armyInstances.push_back(instance);
+                }
+            }
+
+            // Refit the scene index, then one frustum query (plus the occlusion test) and one proximity query for the whole army
+            trooperVisible.assign(armyInstances.size(), 0);
+            trooperNear.assign(armyInstances.size(), 0);
+            sceneIndex.QueryFrustum(frustum, sceneHits);
+            CullStats armyCull;
+            for (int id : sceneHits)
+            {
+                if (id < (int)objectTrooper.size() && objectTrooper[id] >= 0)
+                {
+                    if (!occlusion.IsVisible(sceneIndex.GetBounds(id)))
+                    {
+                        armyCull.occluded++;
+                        continue;
+                    }
+                    trooperVisible[objectTrooper[id]] = 1;
+                    armyCull.visible++;
+                }
+            }
+            armyCull.culled = armyInstances.size() - armyCull.visible - armyCull.occluded;
+            frameCull.Add(armyCull);
+            sceneIndex.QuerySphere(camera.position, crowdDistance, sceneHits);
+            for (int id : sceneHits)
             {
-                glm::mat4 trooperModel = glm::mat4(1.0f);
-                // Translate relative to a moving base to keep up with camera
-                trooperModel = glm::translate(trooperModel, glm::vec3((float)x * 2.0f, 0.0f, (float)z * 2.0f - worldOffset));
-                trooperModel = glm::rotate(trooperModel, glm::radians(180.0f), glm::vec3(0.0f, 1.0f, 0.0f)); 
-                trooperModel = glm::scale(trooperModel, glm::vec3(0.02f, 0.02f, 0.02f)); 
-                ourShader.setMat4("model", trooperModel);
-                ourModel.Draw(ourShader);
+                if (id < (int)objectTrooper.size() && objectTrooper[id] >= 0)
+                    trooperNear[objectTrooper[id]] = 1;
             }
+
+            for (size_t t = 0; t < armyInstances.size(); t++)
+            {
+                if (!trooperVisible[t])
+                    continue;
+                InstanceData& instance = armyInstances[t];
+                if (bakedWalk.texture != 0 && !trooperNear[t])
+                {
+                    crowdInstances.push_back(instance);
+                    continue;
+                }
+
+                // One palette per distinct pose bucket
+                if (ourModel.HasAnimations())
+                {
+                    const vector<glm::mat4>* pose = &poseCache.GetPose(ourModel, 0, currentFrame * instance.speed + instance.phase);
+                    auto palette = posePalettes.find(pose);
+                    if (palette == posePalettes.end())
+                        palette = posePalettes.emplace(pose, bonePalettes->Add(*pose)).first;
+                    instance.paletteIndex = palette->second;
+                }
+                trooperInstances.push_back(instance);
+            }
+            bonePalettes->Upload();
+
+            // Near and far troopers share one instance upload; the crowd starts right after the near ones
+            unsigned int nearCount = trooperInstances.size();
+            trooperInstances.insert(trooperInstances.end(), crowdInstances.begin(), crowdInstances.end());
+            trooperInstanceBuffer.Upload(trooperInstances);
+
+            ourShader.use();
+            ourShader.setInt("bonesPerPalette", bonePalettes->GetBonesPerPalette());
+            ourModel.DrawInstanced(ourShader, trooperInstanceBuffer, nearCount);
+
+            // Distant troopers: the GPU picks the pose from the baked bone texture
+            if (!crowdInstances.empty())
+            {
+                crowdShader.use();
+                crowdShader.setFloat("time", currentFrame);
+                crowdShader.setInt("boneCount", bakedWalk.boneCount);
+                crowdShader.setInt("boneFrameCount", bakedWalk.frameCount);
+                crowdShader.setFloat("boneFramesPerSecond", bakedWalk.framesPerSecond);
+                crowdShader.setInt("boneTexture", 8);
+                glState.BindTexture(8, bakedWalk.texture);
+                ourModel.DrawInstanced(crowdShader, trooperInstanceBuffer, crowdInstances.size(), nearCount);
+            }
+        }
+
+        // Everything opaque is in the depth buffer; next frame's GPU culling tests against it
+        if (hiZ) {
+            int framebufferWidth, framebufferHeight;
+            glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+            hiZ->Build(framebufferWidth, framebufferHeight, viewProjection);
         }
 
         // 5. Draw HUD (FPS Counter)
-        glEnable(GL_BLEND);
+        glState.SetBlend(true);
         hudShader.use();
         hudShader.setInt("fps", fps);
         hudShader.setVec3("textColor", glm::vec3(0.0f, 1.0f, 0.0f)); // Bright green
-        glBindVertexArray(hudVAO);
+        glState.BindVertexArray(hudVAO);
         glDrawArrays(GL_TRIANGLES, 0, 6);
-        glDisable(GL_BLEND);
+        glState.SetBlend(false);
+
+        lastCull = frameCull;
 
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
-    if (audioLoaded) {
-        ma_sound_uninit(&bgMusic);
+    // Nothing may still be loading into the engine or GL objects while they are torn down
+    AssetLoader::Get().Flush();
+    if (bgMusic.IsReady()) {
+        ma_sound_uninit(bgMusic.Get());
+    }
+    if (engineReady) {
+        ma_engine_uninit(&engine);
     }
-    ma_engine_uninit(&engine);
 
     glfwTerminate();
     return 0;
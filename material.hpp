@@ -0,0 +1,96 @@
+#ifndef MATERIAL_HPP
+#define MATERIAL_HPP
+
+#include <glad/glad.h>
+#include <gl_state.hpp>
+#include <glm/glm.hpp>
+#include <shader.hpp>
+#include <texture_cache.hpp>
+
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+struct Texture
+{
+    unsigned int id;
+    string type;
+    string path;
+};
+
+// std140 layout of the MaterialData block in shader.frag
+struct MaterialUniformData
+{
+    glm::vec4 baseColor = glm::vec4(0.8f, 0.5f, 0.2f, 1.0f);
+};
+
+// Textures and constants of one imported material, resolved at load time. Each texture
+// already knows its fixed unit (materialTextureUnit), so binding is a run of
+// glBindTexture calls and one uniform buffer bind, with no uniform lookups.
+class Material
+{
+public:
+    Material(const vector<Texture>& textures, const MaterialUniformData& data) : textures(textures), data(data)
+    {
+        unordered_map<string, unsigned int> counts;
+        for (const Texture& texture : textures)
+        {
+            int unit = materialTextureUnit(texture.type, ++counts[texture.type]);
+            if (unit < 0)
+            {
+                cout << "DEBUG: Material has no unit for " << texture.type << ", skipping " << texture.path << endl;
+                continue;
+            }
+            bindings.push_back({ (unsigned int)unit, texture.id });
+        }
+
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(MaterialUniformData), &this->data, GL_STATIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    // Materials hold one TextureCache reference per texture.
+    ~Material()
+    {
+        for (const Texture& texture : textures)
+            TextureCache::Get().Release(texture.id);
+        GetGLState().ForgetBuffer(UBO);
+        glDeleteBuffers(1, &UBO);
+    }
+
+    Material(const Material&) = delete;
+    Material& operator=(const Material&) = delete;
+
+    const vector<Texture>& GetTextures() const { return textures; }
+    bool HasTextures() const { return !bindings.empty(); }
+
+    // Every call goes through GLStateCache, so rebinding the material that is already
+    // bound (e.g. the same model drawn twice in a frame) issues nothing. Textures are
+    // still resolved each time, so a placeholder is swapped out once its load lands.
+    void Bind() const
+    {
+        GLStateCache& glState = GetGLState();
+        for (const TextureBinding& binding : bindings)
+        {
+            glState.BindTexture(binding.unit, TextureCache::Get().Resolve(binding.texture));
+        }
+        glState.BindUniformBuffer(MATERIAL_UNIFORMS_BINDING, UBO);
+    }
+
+private:
+    struct TextureBinding
+    {
+        unsigned int unit;
+        unsigned int texture;
+    };
+
+    vector<Texture> textures;
+    MaterialUniformData data;
+    vector<TextureBinding> bindings;
+    unsigned int UBO = 0;
+};
+
+#endif
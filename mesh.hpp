@@ -5,136 +5,70 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <shader.hpp>
+#include <vertex_layout.hpp>
+#include <geometry_pool.hpp>
+#include <material.hpp>
+#include <bounds.hpp>
 
-#include <string>
+#include <algorithm>
 #include <vector>
 using namespace std;
 
-#define MAX_BONE_INFLUENCE 4
-
-struct Vertex
+class InstanceBuffer
 {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 texCoords;
-    glm::vec3 tangent;
-    glm::vec3 bitangent;
-    
-    int m_BoneIDs[MAX_BONE_INFLUENCE];
-    float m_Weights[MAX_BONE_INFLUENCE];
-
-    void SetBoneDataDefault()
+public:
+    InstanceBuffer()
     {
-        for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
-        {
-            m_BoneIDs[i] = -1;
-            m_Weights[i] = 0.0f;
-        }
+        glGenBuffers(1, &VBO);
     }
-};
-
-
-void bindbuffer(unsigned int &VAO,unsigned int &VBO,unsigned int &EBO,vector<Vertex>vertices,vector<unsigned int>indices)
-{
-    glGenVertexArrays(1,&VAO);
-    glGenBuffers(1,&VBO);
-    glGenBuffers(1,&EBO);
-    
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER,VBO);
-    glBufferData(GL_ARRAY_BUFFER,vertices.size()*sizeof(Vertex),&vertices[0],GL_STATIC_DRAW);
-    
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,indices.size()*sizeof(unsigned int),&indices[0],GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0,3,GL_FLOAT,GL_FALSE,sizeof(Vertex),(void*)0);
-
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1,3,GL_FLOAT,GL_FALSE,sizeof(Vertex),(void*)offsetof(Vertex,normal));
 
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2,2,GL_FLOAT,GL_FALSE,sizeof(Vertex),(void*)offsetof(Vertex,texCoords));
-
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3,3,GL_FLOAT,GL_FALSE,sizeof(Vertex),(void*)offsetof(Vertex,tangent));
+    ~InstanceBuffer()
+    {
+        glDeleteBuffers(1, &VBO);
+    }
 
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4,3,GL_FLOAT,GL_FALSE,sizeof(Vertex),(void*)offsetof(Vertex,bitangent));
+    InstanceBuffer(const InstanceBuffer&) = delete;
+    InstanceBuffer& operator=(const InstanceBuffer&) = delete;
 
-    glEnableVertexAttribArray(5);
-    glVertexAttribIPointer(5, 4, GL_INT, sizeof(Vertex), (void*)offsetof(Vertex, m_BoneIDs));
+    unsigned int GetID() const { return VBO; }
 
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, m_Weights));
-    
-    glBindVertexArray(0);    
-}
+    void Upload(const vector<InstanceData>& instances)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        capacity = max(capacity, max(instances.size(), (size_t)1) * sizeof(InstanceData));
+        glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_DYNAMIC_DRAW);
+        if (!instances.empty())
+            glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), &instances[0]);
+    }
 
-struct Texture
-{
-    unsigned int id;
-    string type;
-    string path;
+private:
+    unsigned int VBO = 0;
+    size_t capacity = 0;
 };
 
+// Where an imported mesh part lives in the GeometryPool. The geometry is uploaded
+// before the Mesh is made and no CPU copy is kept. The material is owned by the
+// Model; meshes of one imported material share it. Model draws meshes in batches;
+// see Model::Draw.
 class Mesh
 {
 public:
- Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
- {
-    this->vertices = vertices;
-    this->textures = textures;
-    this->indices = indices;
-
-    setupMesh();
- }
- void Draw(Shader& shader)
+ Mesh(const GeometryAllocation& geometry, const Material* material, VertexFormat format, GLenum indexType, const Bounds& bounds)
+    : geometry(geometry), material(material), format(format), indexType(indexType), bounds(bounds)
  {
-    unsigned int diffuse{1};
-    unsigned int normal{1};
-    unsigned int specular{1};
-    unsigned int height{1};
-
-    shader.setBool("hasTexture", textures.size() > 0);
-    for(unsigned int i=0; i<textures.size(); i++)
-    {
-        glActiveTexture(GL_TEXTURE0 + i);
-        string number;
-        string name = textures[i].type;
-        if(name=="texture_diffuse")
-        {
-            number = std::to_string(diffuse++);
-        }
-        else if(name=="texture_specular")
-        {
-            number = std::to_string(specular++);
-        }
-        else if(name=="texture_normal")
-        {
-            number = std::to_string(normal++);
-        }
-        else if(name=="texture_height")
-        {
-            number = std::to_string(height++);
-        }
-        shader.setInt((name + number).c_str(), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
-    }
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES,indices.size(),GL_UNSIGNED_INT,0);
-    glBindVertexArray(0);
-    glActiveTexture(GL_TEXTURE0);
  }
+ VertexFormat GetVertexFormat() const { return format; }
+ GLenum GetIndexType() const { return indexType; }
+ const GeometryAllocation& GetGeometry() const { return geometry; }
+ const Material* GetMaterial() const { return material; }
+ bool HasTextures() const { return material && material->HasTextures(); }
+ const Bounds& GetBounds() const { return bounds; }
 private:
-    unsigned int VAO,VBO,EBO;
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
-    void setupMesh()
-    {
-        bindbuffer(VAO,VBO,EBO,vertices,indices);
-    }
+    GeometryAllocation geometry;
+    const Material* material;
+    VertexFormat format;
+    GLenum indexType;
+    Bounds bounds;
 };
 
-#endif
\ No newline at end of file
+#endif
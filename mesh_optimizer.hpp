@@ -0,0 +1,418 @@
+#ifndef MESH_OPTIMIZER_HPP
+#define MESH_OPTIMIZER_HPP
+
+#include <glm/glm.hpp>
+#include <vertex_layout.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+#define VERTEX_CACHE_SIZE 32
+
+#define MAX_SHORT_INDEX_VERTICES 65536
+
+// Meshes that fit 16-bit indices get a GL_UNSIGNED_SHORT index buffer.
+GLenum chooseIndexType(size_t vertexCount)
+{
+    return vertexCount <= MAX_SHORT_INDEX_VERTICES ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+struct MeshPart
+{
+    vector<Vertex> vertices;
+    vector<unsigned int> indices;
+};
+
+// Splits a triangle list into parts of at most maxVertices vertices each, so every
+// part can be drawn with 16-bit indices. Triangles stay in their original order.
+vector<MeshPart> splitForShortIndices(const vector<Vertex>& vertices, const vector<unsigned int>& indices, size_t maxVertices = MAX_SHORT_INDEX_VERTICES)
+{
+    vector<MeshPart> parts;
+    if (vertices.size() <= maxVertices)
+    {
+        parts.push_back({ vertices, indices });
+        return parts;
+    }
+
+    unordered_map<unsigned int, unsigned int> remap;
+    parts.emplace_back();
+    for (size_t i = 0; i + 2 < indices.size(); i += 3)
+    {
+        size_t added = 0;
+        for (int j = 0; j < 3; j++)
+            added += remap.count(indices[i + j]) ? 0 : 1;
+        if (parts.back().vertices.size() + added > maxVertices)
+        {
+            parts.emplace_back();
+            remap.clear();
+        }
+
+        MeshPart& part = parts.back();
+        for (int j = 0; j < 3; j++)
+        {
+            auto it = remap.find(indices[i + j]);
+            if (it == remap.end())
+            {
+                it = remap.emplace(indices[i + j], part.vertices.size()).first;
+                part.vertices.push_back(vertices[indices[i + j]]);
+            }
+            part.indices.push_back(it->second);
+        }
+    }
+    return parts;
+}
+
+// Post-transform cache statistics for a triangle list, measured with a FIFO cache.
+// ACMR is transformed vertices per triangle (0.5 is ideal on a regular grid),
+// ATVR is transformed vertices per unique vertex (1.0 is ideal).
+struct VertexCacheStats
+{
+    float acmr = 0.0f;
+    float atvr = 0.0f;
+};
+
+VertexCacheStats AnalyzeVertexCache(const vector<unsigned int>& indices, size_t vertexCount, int cacheSize = VERTEX_CACHE_SIZE)
+{
+    VertexCacheStats stats;
+    if (indices.empty() || vertexCount == 0)
+        return stats;
+
+    // timestamps instead of an explicit FIFO: a vertex is cached if it entered fewer than cacheSize misses ago
+    vector<unsigned int> insertedAt(vertexCount, 0);
+    unsigned int misses = 0;
+    for (unsigned int index : indices)
+    {
+        if (insertedAt[index] == 0 || misses - insertedAt[index] + 1 > (unsigned int)cacheSize)
+        {
+            misses++;
+            insertedAt[index] = misses;
+        }
+    }
+    stats.acmr = (float)misses / (indices.size() / 3);
+    stats.atvr = (float)misses / vertexCount;
+    return stats;
+}
+
+// Forsyth's linear-speed vertex cache optimisation. Greedily emits the triangle whose
+// vertices score best, favouring vertices already in the simulated LRU cache and
+// vertices with few remaining triangles so the mesh is consumed in tight fans.
+vector<unsigned int> OptimizeVertexCache(const vector<unsigned int>& indices, size_t vertexCount)
+{
+    const int cacheSize = VERTEX_CACHE_SIZE;
+    size_t triangleCount = indices.size() / 3;
+
+    vector<unsigned int> useCount(vertexCount, 0);
+    for (unsigned int index : indices)
+        useCount[index]++;
+
+    vector<unsigned int> adjacencyStart(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        adjacencyStart[v + 1] = adjacencyStart[v] + useCount[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int j = 0; j < 3; j++)
+            adjacency[fill[indices[t * 3 + j]]++] = t;
+    }
+
+    auto vertexScore = [&](int cachePosition, unsigned int remaining)
+    {
+        if (remaining == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0)
+            score = cachePosition < 3 ? 0.75f : powf(1.0f - (float)(cachePosition - 3) / (cacheSize - 3), 1.5f);
+        return score + 2.0f * powf((float)remaining, -0.5f);
+    };
+
+    vector<int> cachePosition(vertexCount, -1);
+    vector<float> score(vertexCount);
+    for (size_t v = 0; v < vertexCount; v++)
+        score[v] = vertexScore(-1, useCount[v]);
+
+    vector<bool> emitted(triangleCount, false);
+    vector<float> triangleScore(triangleCount);
+    for (size_t t = 0; t < triangleCount; t++)
+        triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    vector<unsigned int> cache;
+    size_t nextUnemitted = 0;
+    int best = triangleCount > 0 ? 0 : -1;
+
+    while (best >= 0)
+    {
+        emitted[best] = true;
+        vector<unsigned int> newCache;
+        for (int j = 0; j < 3; j++)
+        {
+            unsigned int v = indices[best * 3 + j];
+            result.push_back(v);
+            newCache.push_back(v);
+
+            // drop the emitted triangle from the vertex's remaining list
+            unsigned int* begin = &adjacency[adjacencyStart[v]];
+            unsigned int* end = begin + useCount[v];
+            *find(begin, end, (unsigned int)best) = *(end - 1);
+            useCount[v]--;
+        }
+        for (unsigned int v : cache)
+        {
+            if (find(newCache.begin(), newCache.end(), v) == newCache.end())
+                newCache.push_back(v);
+        }
+
+        for (size_t i = 0; i < newCache.size(); i++)
+        {
+            unsigned int v = newCache[i];
+            cachePosition[v] = i < (size_t)cacheSize ? (int)i : -1;
+            score[v] = vertexScore(cachePosition[v], useCount[v]);
+        }
+
+        best = -1;
+        float bestScore = -1.0f;
+        for (unsigned int v : newCache)
+        {
+            for (unsigned int k = 0; k < useCount[v]; k++)
+            {
+                unsigned int t = adjacency[adjacencyStart[v] + k];
+                triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+                if (triangleScore[t] > bestScore)
+                {
+                    bestScore = triangleScore[t];
+                    best = t;
+                }
+            }
+        }
+        if (newCache.size() > (size_t)cacheSize)
+        {
+            for (size_t i = cacheSize; i < newCache.size(); i++)
+                cachePosition[newCache[i]] = -1;
+            newCache.resize(cacheSize);
+        }
+        cache.swap(newCache);
+
+        if (best < 0)
+        {
+            // nothing in the cache has triangles left; restart from the next unemitted one
+            while (nextUnemitted < triangleCount && emitted[nextUnemitted])
+                nextUnemitted++;
+            if (nextUnemitted < triangleCount)
+                best = nextUnemitted;
+        }
+    }
+    return result;
+}
+
+// Splits the cache-optimised order into clusters at points where the cache was flushed
+// and sorts the clusters so outward-facing ones are drawn first. Cuts overdraw from any
+// viewpoint without touching the in-cluster order, so ACMR barely moves.
+vector<unsigned int> OptimizeOverdraw(const vector<unsigned int>& indices, const vector<Vertex>& vertices)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return indices;
+
+    vector<size_t> clusterStart;
+    vector<unsigned int> insertedAt(vertices.size(), 0);
+    unsigned int misses = 0;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        int triangleMisses = 0;
+        for (int j = 0; j < 3; j++)
+        {
+            unsigned int v = indices[t * 3 + j];
+            if (insertedAt[v] == 0 || misses - insertedAt[v] + 1 > VERTEX_CACHE_SIZE)
+            {
+                misses++;
+                insertedAt[v] = misses;
+                triangleMisses++;
+            }
+        }
+        if (t == 0 || triangleMisses == 3)
+            clusterStart.push_back(t);
+    }
+    clusterStart.push_back(triangleCount);
+
+    glm::vec3 meshCenter(0.0f);
+    for (const Vertex& vertex : vertices)
+        meshCenter += vertex.position;
+    meshCenter /= (float)max(vertices.size(), (size_t)1);
+
+    struct Cluster
+    {
+        size_t start;
+        size_t end;
+        float sortKey;
+    };
+    vector<Cluster> clusters;
+    for (size_t c = 0; c + 1 < clusterStart.size(); c++)
+    {
+        glm::vec3 center(0.0f);
+        glm::vec3 normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; t++)
+        {
+            glm::vec3 a = vertices[indices[t * 3]].position;
+            glm::vec3 b = vertices[indices[t * 3 + 1]].position;
+            glm::vec3 e = vertices[indices[t * 3 + 2]].position;
+            glm::vec3 n = glm::cross(b - a, e - a);
+            float triangleArea = glm::length(n);
+            center += (a + b + e) / 3.0f * triangleArea;
+            normal += n;
+            area += triangleArea;
+        }
+        center = area > 0.0f ? center / area : vertices[indices[clusterStart[c] * 3]].position;
+        float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+        clusters.push_back({ clusterStart[c], clusterStart[c + 1], glm::dot(center - meshCenter, normal) });
+    }
+    stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    vector<unsigned int> result;
+    result.reserve(indices.size());
+    for (const Cluster& cluster : clusters)
+        result.insert(result.end(), indices.begin() + cluster.start * 3, indices.begin() + cluster.end * 3);
+    return result;
+}
+
+// Renumbers vertices in first-use order so vertex fetch walks the buffer forwards.
+// Unreferenced vertices are dropped.
+void OptimizeVertexFetch(vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+    const unsigned int unused = ~0u;
+    vector<unsigned int> remap(vertices.size(), unused);
+    vector<Vertex> reordered;
+    reordered.reserve(vertices.size());
+    for (unsigned int& index : indices)
+    {
+        if (remap[index] == unused)
+        {
+            remap[index] = reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(reordered);
+}
+
+// Runs the full import-time pass and reports the cache statistics before and after.
+void OptimizeMesh(const string& name, vector<Vertex>& vertices, vector<unsigned int>& indices)
+{
+    if (indices.size() < 3)
+        return;
+    VertexCacheStats before = AnalyzeVertexCache(indices, vertices.size());
+    indices = OptimizeVertexCache(indices, vertices.size());
+    indices = OptimizeOverdraw(indices, vertices);
+    OptimizeVertexFetch(vertices, indices);
+    VertexCacheStats after = AnalyzeVertexCache(indices, vertices.size());
+    cout << "DEBUG: Optimized " << name << ": ACMR " << before.acmr << " -> " << after.acmr << ", ATVR " << before.atvr << " -> " << after.atvr << endl;
+}
+
+#define OCCLUDER_MAX_TRIANGLES 2048
+
+// Stand-in geometry for software occlusion culling (see occlusion_culler.hpp):
+// positions and a triangle list in model space, no attributes.
+struct OccluderMesh
+{
+    vector<glm::vec3> vertices;
+    vector<unsigned int> indices;
+
+    bool IsEmpty() const { return indices.empty(); }
+};
+
+// Vertex clustering (Rossignac-Borrel): snap every vertex to a grid cell, replace each
+// cell by the mean of its vertices and drop triangles that collapse. The grid starts
+// at 64 cells along the longest axis and halves until the result fits maxTriangles.
+// Thin parts vanish rather than grow, so the occluder rarely covers more than the
+// original silhouette.
+OccluderMesh BuildOccluderMesh(const vector<glm::vec3>& positions, const vector<unsigned int>& indices, size_t maxTriangles = OCCLUDER_MAX_TRIANGLES)
+{
+    OccluderMesh occluder;
+    if (positions.empty() || indices.size() < 3)
+        return occluder;
+
+    glm::vec3 lower(FLT_MAX), upper(-FLT_MAX);
+    for (const glm::vec3& position : positions)
+    {
+        lower = glm::min(lower, position);
+        upper = glm::max(upper, position);
+    }
+    glm::vec3 size = upper - lower;
+    float longest = max(size.x, max(size.y, size.z));
+    if (longest <= 0.0f)
+        return occluder;
+
+    for (int resolution = 64; resolution >= 2; resolution /= 2)
+    {
+        float cellSize = longest / resolution;
+        unordered_map<uint64_t, unsigned int> cells;
+        vector<unsigned int> remap(positions.size());
+        vector<glm::vec3> sums;
+        vector<unsigned int> counts;
+        for (size_t i = 0; i < positions.size(); i++)
+        {
+            glm::vec3 cell = glm::min((positions[i] - lower) / cellSize, glm::vec3((float)resolution - 1.0f));
+            uint64_t key = ((uint64_t)cell.x << 42) | ((uint64_t)cell.y << 21) | (uint64_t)cell.z;
+            auto found = cells.find(key);
+            if (found == cells.end())
+            {
+                found = cells.emplace(key, sums.size()).first;
+                sums.push_back(glm::vec3(0.0f));
+                counts.push_back(0);
+            }
+            remap[i] = found->second;
+            sums[found->second] += positions[i];
+            counts[found->second]++;
+        }
+
+        // rotate each triangle so its smallest index leads; duplicates then compare equal
+        vector<array<unsigned int, 3>> triangles;
+        for (size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (a == b || b == c || a == c)
+                continue;
+            if (b < a && b < c)
+                triangles.push_back({ b, c, a });
+            else if (c < a && c < b)
+                triangles.push_back({ c, a, b });
+            else
+                triangles.push_back({ a, b, c });
+        }
+        sort(triangles.begin(), triangles.end());
+        triangles.erase(unique(triangles.begin(), triangles.end()), triangles.end());
+        if (triangles.size() > maxTriangles && resolution > 2)
+            continue;
+
+        // keep only the cells still referenced
+        const unsigned int unused = ~0u;
+        vector<unsigned int> used(sums.size(), unused);
+        for (const array<unsigned int, 3>& triangle : triangles)
+        {
+            for (unsigned int cell : triangle)
+            {
+                if (used[cell] == unused)
+                {
+                    used[cell] = occluder.vertices.size();
+                    occluder.vertices.push_back(sums[cell] / (float)counts[cell]);
+                }
+                occluder.indices.push_back(used[cell]);
+            }
+        }
+        break;
+    }
+    return occluder;
+}
+
+#endif
@@ -1,497 +1,250 @@
 #ifndef MODEL_HPP
 #define MODEL_HPP
 
-#include <assimp/Importer.hpp>
-#include <assimp/scene.h>
-#include <assimp/postprocess.h>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <shader.hpp>
-#define STB_IMAGE_IMPLEMENTATION
-#include <libraries/assimp/contrib/stb/stb_image.h>
+#include <texture_cache.hpp>
 #include <mesh.hpp>
+#include <skeleton.hpp>
+#include <animation.hpp>
+#include <model_import.hpp>
+#include <cooked_model.hpp>
+#include <bounds.hpp>
+#include <frustum.hpp>
 #include <string>
 #include <vector>
 #include <map>
+#include <memory>
 using namespace std;
 
-class AssimpGLMHelpers
-{
-public:
-    static inline glm::mat4 ConvertMatrixToGLMFormat(const aiMatrix4x4& from)
-    {
-        glm::mat4 to;
-        to[0][0] = from.a1; to[1][0] = from.a2; to[2][0] = from.a3; to[3][0] = from.a4;
-        to[0][1] = from.b1; to[1][1] = from.b2; to[2][1] = from.b3; to[3][1] = from.b4;
-        to[0][2] = from.c1; to[1][2] = from.c2; to[2][2] = from.c3; to[3][2] = from.c4;
-        to[0][3] = from.d1; to[1][3] = from.d2; to[2][3] = from.d3; to[3][3] = from.d4;
-        return to;
-    }
-
-    static inline glm::vec3 GetGLMVec(const aiVector3D& vec) 
-    { 
-        return glm::vec3(vec.x, vec.y, vec.z); 
-    }
-
-    static inline glm::quat GetGLMQuat(const aiQuaternion& pOrientation)
-    {
-        return glm::quat(pOrientation.w, pOrientation.x, pOrientation.y, pOrientation.z);
-    }
-};
-
-struct BoneInfo
-{
-    int id;
-    glm::mat4 offset;
-};
-
-vector<Vertex> fillVertices(aiMesh* mesh)
-{
-    vector<Vertex> vertices;
-    bool hasTexCoords = mesh->mTextureCoords[0] != nullptr;
-    cout << "DEBUG: Mesh " << mesh->mName.C_Str() << " has UVs: " << (hasTexCoords ? "YES" : "NO") << endl;
-    for(unsigned int i=0; i<mesh->mNumVertices; i++)
-    {
-        Vertex vertex;
-        vertex.SetBoneDataDefault();
-        glm::vec3 vector;
-        // positions
-        vector.x = mesh->mVertices[i].x;
-        vector.y = mesh->mVertices[i].y;
-        vector.z = mesh->mVertices[i].z;
-        vertex.position = vector;
-        // normals
-        if (mesh->HasNormals())
-        {
-            vector.x = mesh->mNormals[i].x;
-            vector.y = mesh->mNormals[i].y;
-            vector.z = mesh->mNormals[i].z;
-            vertex.normal = vector;
-        }
-        // texture coordinates
-        if(mesh->mTextureCoords[0])
-        {
-            glm::vec2 vec;
-            vec.x = mesh->mTextureCoords[0][i].x; 
-            vec.y = mesh->mTextureCoords[0][i].y;
-            vertex.texCoords = vec;
-            // tangents
-            if (mesh->HasTangentsAndBitangents())
-            {
-                vector.x = mesh->mTangents[i].x;
-                vector.y = mesh->mTangents[i].y;
-                vector.z = mesh->mTangents[i].z;
-                vertex.tangent = vector;
-                // bitangents
-                vector.x = mesh->mBitangents[i].x;
-                vector.y = mesh->mBitangents[i].y;
-                vector.z = mesh->mBitangents[i].z;
-                vertex.bitangent = vector;
-            }
-        }
-        else
-            vertex.texCoords = glm::vec2(0.0f, 0.0f);
-
-        vertices.push_back(vertex);
-    }
-    return vertices;
-}
-
-vector<unsigned int>fillIndices(aiMesh* mesh)
-{
-    vector<unsigned int> indices;
-    for(unsigned int i=0;i<mesh->mNumFaces;i++)
-    {
-        aiFace face = mesh->mFaces[i];
-        for(unsigned int j=0;j<face.mNumIndices;j++)
-        {
-            indices.push_back(face.mIndices[j]);
-        }
-    }
-    return indices;
-};
-
-
 class Model
 {
 public:
     std::map<string, BoneInfo> m_BoneInfoMap;
     int m_BoneCounter = 0;
 
-    Model(string const &path)
+    // Auto packs skinned models into the 32 byte layout and everything else into 24 bytes.
+    // Loads the cooked copy when it is current, otherwise imports through Assimp.
+    Model(string const &path, VertexFormat format = VertexFormat::Auto) : m_VertexFormat(format)
     {
-        loadModel(path);
+        ModelData data;
+        if (LoadModelData(path, format, data))
+            upload(data);
     }
-    void Draw(Shader& shader)
+    // GL half of loading, for data imported elsewhere; data is moved from.
+    Model(ModelData& data) : m_VertexFormat(data.format)
     {
-        for(unsigned int i=0;i<meshes.size();i++)
-        {
-            meshes[i].Draw(shader);
-        }        
+        upload(data);
     }
-
-    auto& GetBoneInfoMap() { return m_BoneInfoMap; }
-    int& GetBoneCount() { return m_BoneCounter; }
-
-    void UpdateAnimation(float currentTime, const aiScene* scene, vector<glm::mat4>& transforms)
+    // One glMultiDrawElementsIndirect per batch of meshes sharing a material
+    void Draw(Shader& shader)
     {
-        if (scene->mNumAnimations > 0)
-        {
-            aiAnimation* animation = scene->mAnimations[0];
-            float ticksPerSecond = animation->mTicksPerSecond != 0 ? animation->mTicksPerSecond : 25.0f;
-            float timeInTicks = currentTime * ticksPerSecond;
-            float animationTime = fmod(timeInTicks, (float)animation->mDuration);
-
-            CalculateBoneTransform(scene->mRootNode, animation, animationTime, glm::mat4(1.0f), transforms);
-        }
+        drawBatches(shader, GetGeometryPool().GetDefaultInstanceBuffer(), 1, 0, nullptr);
     }
-
-    void CalculateBoneTransform(const aiNode* node, const aiAnimation* animation, float animationTime, glm::mat4 parentTransform, vector<glm::mat4>& transforms)
+    // Draw with per-mesh frustum culling. localFrustum is in this model's space, i.e.
+    // ExtractFrustum(projection * view * model), so the mesh spheres never move.
+    // Culled meshes keep their command with an instance count of 0.
+    CullStats DrawCulled(Shader& shader, const Frustum& localFrustum)
     {
-        string nodeName(node->mName.data);
-        glm::mat4 nodeTransform = AssimpGLMHelpers::ConvertMatrixToGLMFormat(node->mTransformation);
-
-        const aiNodeAnim* nodeAnim = FindNodeAnim(animation, nodeName);
-
-        if (nodeAnim)
-        {
-            glm::mat4 translation = InterpolateTranslation(animationTime, nodeAnim);
-            glm::mat4 rotation = InterpolateRotation(animationTime, nodeAnim);
-            glm::mat4 scale = InterpolateScaling(animationTime, nodeAnim);
-            nodeTransform = translation * rotation * scale;
-        }
-
-        glm::mat4 globalTransformation = parentTransform * nodeTransform;
-
-        if (m_BoneInfoMap.find(nodeName) != m_BoneInfoMap.end())
-        {
-            int index = m_BoneInfoMap[nodeName].id;
-            glm::mat4 offset = m_BoneInfoMap[nodeName].offset;
-            transforms[index] = globalTransformation * offset;
-        }
-
-        for (int i = 0; i < node->mNumChildren; i++)
-            CalculateBoneTransform(node->mChildren[i], animation, animationTime, globalTransformation, transforms);
-    }
-
-    const aiNodeAnim* FindNodeAnim(const aiAnimation* animation, string nodeName)
-    {
-        for (int i = 0; i < animation->mNumChannels; i++)
-        {
-            const aiNodeAnim* nodeAnim = animation->mChannels[i];
-            if (string(nodeAnim->mNodeName.data) == nodeName)
-                return nodeAnim;
-        }
-        return nullptr;
+        CullStats stats = m_MeshCuller.Cull(localFrustum, m_MeshVisible);
+        if (stats.visible > 0)
+            drawBatches(shader, GetGeometryPool().GetDefaultInstanceBuffer(), 1, 0, &m_MeshVisible);
+        return stats;
     }
-
-    glm::mat4 InterpolateTranslation(float animationTime, const aiNodeAnim* nodeAnim)
+    // Same batches, with count instances starting at baseInstance of the instance buffer
+    void DrawInstanced(Shader& shader, const InstanceBuffer& instances, unsigned int count, unsigned int baseInstance = 0)
     {
-        if (nodeAnim->mNumPositionKeys == 1)
-            return glm::translate(glm::mat4(1.0f), AssimpGLMHelpers::GetGLMVec(nodeAnim->mPositionKeys[0].mValue));
-
-        int p0Index = GetPositionIndex(animationTime, nodeAnim);
-        int p1Index = p0Index + 1;
-        float lerpFactor = GetLerpFactor(animationTime, nodeAnim->mPositionKeys[p0Index].mTime, nodeAnim->mPositionKeys[p1Index].mTime);
-        glm::vec3 finalTranslation = glm::mix(AssimpGLMHelpers::GetGLMVec(nodeAnim->mPositionKeys[p0Index].mValue), AssimpGLMHelpers::GetGLMVec(nodeAnim->mPositionKeys[p1Index].mValue), lerpFactor);
-        return glm::translate(glm::mat4(1.0f), finalTranslation);
+        if (count == 0)
+            return;
+        drawBatches(shader, instances.GetID(), count, baseInstance, nullptr);
     }
+    int GetDrawBatchCount() const { return m_Batches.size(); }
 
-    glm::mat4 InterpolateRotation(float animationTime, const aiNodeAnim* nodeAnim)
+    // One command per mesh in draw order, with instanceCount 0 and baseInstance 0, for a
+    // GPU pass to fill in (see InstanceCuller). The layout matches DrawIndirect.
+    vector<DrawElementsIndirectCommand> GetIndirectCommands() const
     {
-        if (nodeAnim->mNumRotationKeys == 1)
+        vector<DrawElementsIndirectCommand> commands;
+        for (unsigned int index : m_DrawOrder)
         {
-            auto rotation = AssimpGLMHelpers::GetGLMQuat(nodeAnim->mRotationKeys[0].mValue);
-            return glm::mat4_cast(rotation);
+            const GeometryAllocation& geometry = meshes[index].GetGeometry();
+            commands.push_back({ geometry.indexCount, 0, geometry.firstIndex, geometry.baseVertex, 0 });
         }
-
-        int r0Index = GetRotationIndex(animationTime, nodeAnim);
-        int r1Index = r0Index + 1;
-        float lerpFactor = GetLerpFactor(animationTime, nodeAnim->mRotationKeys[r0Index].mTime, nodeAnim->mRotationKeys[r1Index].mTime);
-        glm::quat finalRotation = glm::slerp(AssimpGLMHelpers::GetGLMQuat(nodeAnim->mRotationKeys[r0Index].mValue), AssimpGLMHelpers::GetGLMQuat(nodeAnim->mRotationKeys[r1Index].mValue), lerpFactor);
-        return glm::mat4_cast(finalRotation);
+        return commands;
     }
-
-    glm::mat4 InterpolateScaling(float animationTime, const aiNodeAnim* nodeAnim)
+    // Same batches, but the commands (instance counts included) come from indirectBuffer,
+    // written on the GPU; the CPU never learns how many instances are drawn.
+    void DrawIndirect(Shader& shader, unsigned int instanceBuffer, unsigned int indirectBuffer)
     {
-        if (nodeAnim->mNumScalingKeys == 1)
-            return glm::scale(glm::mat4(1.0f), AssimpGLMHelpers::GetGLMVec(nodeAnim->mScalingKeys[0].mValue));
-
-        int s0Index = GetScalingIndex(animationTime, nodeAnim);
-        int s1Index = s0Index + 1;
-        float lerpFactor = GetLerpFactor(animationTime, nodeAnim->mScalingKeys[s0Index].mTime, nodeAnim->mScalingKeys[s1Index].mTime);
-        glm::vec3 finalScale = glm::mix(AssimpGLMHelpers::GetGLMVec(nodeAnim->mScalingKeys[s0Index].mValue), AssimpGLMHelpers::GetGLMVec(nodeAnim->mScalingKeys[s1Index].mValue), lerpFactor);
-        return glm::scale(glm::mat4(1.0f), finalScale);
+        if (m_Batches.empty())
+            return;
+        m_DrawData.clear();
+        for (unsigned int index : m_DrawOrder)
+            m_DrawData.push_back({ meshes[index].HasTextures() ? 1 : 0, { 0, 0, 0 } });
+        m_MultiDraw.UploadDrawData(m_DrawData);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        submitBatches(shader, instanceBuffer);
     }
 
-    float GetLerpFactor(float animationTime, float lastTimeStamp, float nextTimeStamp)
-    {
-        float midWayLength = animationTime - lastTimeStamp;
-        float framesDiff = nextTimeStamp - lastTimeStamp;
-        return midWayLength / framesDiff;
-    }
+    auto& GetBoneInfoMap() { return m_BoneInfoMap; }
+    int& GetBoneCount() { return m_BoneCounter; }
+    const Skeleton& GetSkeleton() const { return m_Skeleton; }
+    VertexFormat GetVertexFormat() const { return m_VertexFormat; }
+    // Union of the mesh bounds, in model space
+    const Bounds& GetBounds() const { return m_Bounds; }
+    // Simplified model-space geometry for OcclusionCuller; empty for skinned models
+    const OccluderMesh& GetOccluder() const { return m_Occluder; }
 
-    int GetPositionIndex(float animationTime, const aiNodeAnim* nodeAnim)
-    {
-        for (int index = 0; index < nodeAnim->mNumPositionKeys - 1; ++index)
-        {
-            if (animationTime < (float)nodeAnim->mPositionKeys[index + 1].mTime)
-                return index;
-        }
-        return 0;
-    }
+    bool HasAnimations() const { return !m_Animations.empty(); }
+    int GetAnimationCount() const { return m_Animations.size(); }
+    const AnimationClip& GetAnimation(int index) const { return m_Animations[index]; }
 
-    int GetRotationIndex(float animationTime, const aiNodeAnim* nodeAnim)
+    void UpdateAnimation(float currentTime, vector<glm::mat4>& transforms)
     {
-        for (int index = 0; index < nodeAnim->mNumRotationKeys - 1; ++index)
-        {
-            if (animationTime < (float)nodeAnim->mRotationKeys[index + 1].mTime)
-                return index;
-        }
-        return 0;
+        if (!m_Animations.empty())
+            EvaluatePose(0, m_Animations[0].GetAnimationTime(currentTime), m_Cursor, transforms);
     }
 
-    int GetScalingIndex(float animationTime, const aiNodeAnim* nodeAnim)
+    // animationTime is in clip ticks; cursor belongs to whoever is playing the clip.
+    void EvaluatePose(int clipIndex, float animationTime, AnimationCursor& cursor, vector<glm::mat4>& transforms)
     {
-        for (int index = 0; index < nodeAnim->mNumScalingKeys - 1; ++index)
-        {
-            if (animationTime < (float)nodeAnim->mScalingKeys[index + 1].mTime)
-                return index;
-        }
-        return 0;
+        const AnimationClip& clip = m_Animations[clipIndex];
+        m_LocalPose = m_Skeleton.bindLocal;
+        clip.Sample(animationTime, m_LocalPose, cursor);
+        m_Skeleton.ComputeBoneTransforms(m_LocalPose, m_GlobalPose, transforms);
     }
 
 private:
     vector<Mesh> meshes;
-    string directory;
 
-    void loadModel(const string& path)
-    {
-        cout << "DEBUG: Loading model from " << path << endl;
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_GenSmoothNormals | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices);
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) 
+    // One per MaterialDesc of the imported data
+    vector<unique_ptr<Material>> m_Materials;
+
+    // Consecutive commands in m_DrawOrder that share an arena and a material
+    struct DrawBatch
+    {
+        GeometryArena* arena;
+        const Material* material;
+        unsigned int firstCommand;
+        unsigned int commandCount;
+    };
+    vector<unsigned int> m_DrawOrder;
+    vector<DrawBatch> m_Batches;
+    vector<DrawElementsIndirectCommand> m_Commands;
+    vector<DrawData> m_DrawData;
+    MultiDrawBuffer m_MultiDraw;
+
+    Bounds m_Bounds;
+    FrustumCuller m_MeshCuller;
+    vector<uint8_t> m_MeshVisible;
+    OccluderMesh m_Occluder;
+
+    VertexFormat m_VertexFormat;
+    vector<AnimationClip> m_Animations;
+    Skeleton m_Skeleton;
+    AnimationCursor m_Cursor;
+    vector<glm::mat4> m_LocalPose;
+    vector<glm::mat4> m_GlobalPose;
+
+    void upload(ModelData& data)
+    {
+        m_VertexFormat = data.format;
+        m_BoneInfoMap = move(data.boneInfoMap);
+        m_BoneCounter = data.boneCounter;
+        m_Skeleton = move(data.skeleton);
+        m_Animations = move(data.animations);
+        m_Occluder = move(data.occluder);
+
+        for (const MaterialDesc& desc : data.materials)
+        {
+            vector<Texture> textures;
+            for (const TextureRef& ref : desc.textures)
+            {
+                Texture texture;
+                texture.id = TextureCache::Get().Acquire(ref.path);
+                texture.type = ref.type;
+                texture.path = ref.path;
+                if (texture.id != 0)
+                    textures.push_back(texture);
+            }
+            MaterialUniformData uniforms;
+            uniforms.baseColor = desc.baseColor;
+            m_Materials.emplace_back(new Material(textures, uniforms));
+        }
+
+        // straight from the storage vectors, or from the mapped pages of a cooked file
+        for (const MeshData& mesh : data.meshes)
         {
-            cout << "ERROR::ASSIMP::" << importer.GetErrorString() << endl;
-            return;
+            GeometryAllocation geometry = GetGeometryPool().Upload(m_VertexFormat, mesh.VertexData(), mesh.vertexCount, mesh.IndexData(), mesh.indexCount, mesh.indexType);
+            meshes.push_back(Mesh(geometry, m_Materials[mesh.material].get(), m_VertexFormat, mesh.indexType, mesh.bounds));
+            m_Bounds.Expand(mesh.bounds);
+            m_MeshCuller.Add(mesh.bounds.GetCenter(), mesh.bounds.radius);
         }
-        directory = path.substr(0,path.find_last_of('/'));
-        cout << "DEBUG: Model directory is " << directory << endl;
-        processNode(scene->mRootNode,scene);
+        buildDrawBatches();
     }
 
-    void processNode(aiNode* node, const aiScene* scene)
+    void buildDrawBatches()
     {
-        for(unsigned int i=0;i<node->mNumMeshes;i++)
+        // meshes that share an arena and a material end up next to each other
+        vector<vector<unsigned int>> groups;
+        for (unsigned int i = 0; i < meshes.size(); i++)
         {
-            aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh,scene));
+            unsigned int g = 0;
+            while (g < groups.size() && !(meshes[groups[g][0]].GetGeometry().arena == meshes[i].GetGeometry().arena && meshes[groups[g][0]].GetMaterial() == meshes[i].GetMaterial()))
+                g++;
+            if (g == groups.size())
+                groups.emplace_back();
+            groups[g].push_back(i);
         }
-        for(unsigned int i=0;i<node->mNumChildren;i++)
+
+        m_DrawOrder.clear();
+        m_Batches.clear();
+        for (const vector<unsigned int>& group : groups)
         {
-            processNode(node->mChildren[i],scene);
+            m_Batches.push_back({ meshes[group[0]].GetGeometry().arena, meshes[group[0]].GetMaterial(), (unsigned int)m_DrawOrder.size(), (unsigned int)group.size() });
+            m_DrawOrder.insert(m_DrawOrder.end(), group.begin(), group.end());
         }
+        cout << "DEBUG: " << meshes.size() << " meshes in " << m_Batches.size() << " draw batch(es)" << endl;
     }
 
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene)
-    {
-        vector<Vertex> vertices = fillVertices(mesh);
-        vector<unsigned int> indices = fillIndices(mesh);
-        vector<Texture> textures;
-
-        ExtractBoneWeightForVertices(vertices, mesh, scene);
-
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        
-        vector<Texture> diffuseMaps = loadMaterialTextures(material,aiTextureType_DIFFUSE,"texture_diffuse");
-        vector<Texture> specularMaps = loadMaterialTextures(material,aiTextureType_SPECULAR,"texture_specular");
-        vector<Texture> normalMaps = loadMaterialTextures(material,aiTextureType_HEIGHT,"texture_normal");      
-        vector<Texture> heightMaps = loadMaterialTextures(material,aiTextureType_AMBIENT,"texture_height");
-
-
-        textures.insert(textures.end(),diffuseMaps.begin(),diffuseMaps.end());
-        textures.insert(textures.end(),normalMaps.begin(),normalMaps.end());
-        textures.insert(textures.end(),heightMaps.begin(),heightMaps.end());
-        textures.insert(textures.end(),specularMaps.begin(),specularMaps.end());
-        
-        return Mesh(vertices,indices,textures);
-    }
-
-    void SetVertexBoneData(Vertex& vertex, int boneID, float weight)
+    // visible, when given, holds one flag per mesh; hidden meshes are drawn with 0 instances.
+    void drawBatches(Shader& shader, unsigned int instanceBuffer, unsigned int count, unsigned int baseInstance, const vector<uint8_t>* visible)
     {
-        for (int i = 0; i < MAX_BONE_INFLUENCE; ++i)
+        if (m_Batches.empty())
+            return;
+        m_Commands.clear();
+        m_DrawData.clear();
+        for (unsigned int index : m_DrawOrder)
         {
-            if (vertex.m_BoneIDs[i] < 0)
-            {
-                vertex.m_Weights[i] = weight;
-                vertex.m_BoneIDs[i] = boneID;
-                break;
-            }
+            const GeometryAllocation& geometry = meshes[index].GetGeometry();
+            unsigned int instanceCount = visible && !(*visible)[index] ? 0 : count;
+            m_Commands.push_back({ geometry.indexCount, instanceCount, geometry.firstIndex, geometry.baseVertex, baseInstance });
+            m_DrawData.push_back({ meshes[index].HasTextures() ? 1 : 0, { 0, 0, 0 } });
         }
+        m_MultiDraw.Upload(m_Commands, m_DrawData);
+        submitBatches(shader, instanceBuffer);
     }
 
-    void ExtractBoneWeightForVertices(vector<Vertex>& vertices, aiMesh* mesh, const aiScene* scene)
+    // Expects the commands on GL_DRAW_INDIRECT_BUFFER and the draw data on DRAW_DATA_BINDING.
+    void submitBatches(Shader& shader, unsigned int instanceBuffer)
     {
-        for (int boneIndex = 0; boneIndex < mesh->mNumBones; ++boneIndex)
+        Uniform<int> drawBase = shader.GetDrawBase();
+        const Material* boundMaterial = nullptr;
+        for (const DrawBatch& batch : m_Batches)
         {
-            int boneID = -1;
-            string boneName = mesh->mBones[boneIndex]->mName.C_Str();
-            if (m_BoneInfoMap.find(boneName) == m_BoneInfoMap.end())
-            {
-                BoneInfo newBoneInfo;
-                newBoneInfo.id = m_BoneCounter;
-                newBoneInfo.offset = AssimpGLMHelpers::ConvertMatrixToGLMFormat(mesh->mBones[boneIndex]->mOffsetMatrix);
-                m_BoneInfoMap[boneName] = newBoneInfo;
-                boneID = m_BoneCounter;
-                m_BoneCounter++;
-            }
-            else
-            {
-                boneID = m_BoneInfoMap[boneName].id;
-            }
-            assert(boneID != -1);
-            auto weights = mesh->mBones[boneIndex]->mWeights;
-            int numWeights = mesh->mBones[boneIndex]->mNumWeights;
-
-            for (int weightIndex = 0; weightIndex < numWeights; ++weightIndex)
+            if (batch.material && batch.material != boundMaterial)
             {
-                int vertexId = weights[weightIndex].mVertexId;
-                float weight = weights[weightIndex].mWeight;
-                assert(vertexId <= vertices.size());
-                SetVertexBoneData(vertices[vertexId], boneID, weight);
+                batch.material->Bind();
+                boundMaterial = batch.material;
             }
+            shader.setInt(drawBase, batch.firstCommand);
+            GetGLState().BindVertexArray(batch.arena->GetVAO());
+            glBindVertexBuffer(GEOMETRY_INSTANCE_BINDING, instanceBuffer, 0, sizeof(InstanceData));
+            glMultiDrawElementsIndirect(GL_TRIANGLES, batch.arena->GetIndexType(), (void*)(batch.firstCommand * sizeof(DrawElementsIndirectCommand)), batch.commandCount, 0);
         }
     }
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
-    {
-        vector<Texture> textures;
-        
-        // SPECIAL CASE: WSKRS always uses this specific texture for diffuse
-        if (directory.find("wskrs") != string::npos) {
-            if (typeName == "texture_diffuse") {
-                string forcedPath = directory + "/../textures/0de74da3bcee217e5bac706608edf79f.jpg";
-                cout << "WSKRS Special: FORCING load of " << forcedPath << endl;
-                Texture texture;
-                texture.id = loadTexture(forcedPath);
-                if (texture.id != 0) {
-                    texture.type = typeName;
-                    texture.path = "forced_wskrs_texture";
-                    textures.push_back(texture);
-                    return textures; 
-                }
-            }
-        }
-
-        // SPECIAL CASE: Star Cruiser Enigma
-        if (directory.find("star-cruiser-x-enigma") != string::npos) {
-            string texName = "";
-            if (typeName == "texture_diffuse") texName = "model_baseColor.png";
-            else if (typeName == "texture_emissive") texName = "model_emissive.png";
-
-            if (texName != "") {
-                string forcedPath = directory + "/textures/" + texName;
-                cout << "ENIGMA Special: FORCING load of " << forcedPath << " for " << typeName << endl;
-                Texture texture;
-                texture.id = loadTexture(forcedPath);
-                if (texture.id != 0) {
-                    texture.type = typeName;
-                    texture.path = "forced_enigma_" + typeName;
-                    textures.push_back(texture);
-                    return textures;
-                }
-            }
-        }
-
-        for(unsigned int i=0; i<mat->GetTextureCount(type); i++)
-        {
-            aiString str;
-            mat->GetTexture(type, i, &str);
-            string texPath = string(str.C_Str());
-            
-            // Handle Windows/Linux path separators
-            size_t lastBackslash = texPath.find_last_of('\\');
-            size_t lastSlash = texPath.find_last_of('/');
-            size_t lastSpec = (lastBackslash == string::npos) ? lastSlash : (lastSlash == string::npos ? lastBackslash : max(lastSlash, lastBackslash));
-            
-            string filename = (lastSpec == string::npos) ? texPath : texPath.substr(lastSpec + 1);
-            string parentDir = "";
-            if (lastSpec != string::npos) {
-                size_t prevSpec = texPath.find_last_of("\\/", lastSpec - 1);
-                parentDir = (prevSpec == string::npos) ? texPath.substr(0, lastSpec) : texPath.substr(prevSpec + 1, lastSpec - prevSpec - 1);
-            }
-
-            Texture texture;
-            string texturesDir = directory + "/../textures/";
-            
-            // Heuristic for Storm Trooper model: maps "body/diffuse.png" to "diffuse_body.png"
-            string mappedName = filename;
-            if (filename == "diffuse.png" && parentDir != "") {
-                mappedName = "diffuse_" + parentDir + ".png";
-                if (parentDir == "helmet") mappedName = "diffuse_helmets.png";
-            }
-
-            string fullPath = directory + "/" + filename;
-            string mappedPath = texturesDir + mappedName;
-            
-            // Try different paths and naming conventions
-            texture.id = loadTexture(mappedPath);
-            if (texture.id == 0) {
-
-                // Force first texture for WSKRS model
-                if (directory.find("wskrs") != string::npos) {
-                    texture.id = loadTexture(directory + "/../textures/0de74da3bcee217e5bac706608edf79f.jpg");
-                }
-            }
-            if (texture.id == 0) texture.id = loadTexture(texturesDir + filename);
-            if (texture.id == 0) texture.id = loadTexture(fullPath);
-            
-            if (texture.id != 0) {
-                cout << "SUCCESS: Loaded texture " << mappedPath << endl;
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-            } else {
-                cout << "FAILED: Could not load texture from file " << filename << endl;
-            }
-        }
-        return textures;
-    }
-    
-    unsigned int loadTexture(string const& path)
-    {
-        int width, height, nrComponents;
-        unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0); 
-        if(data)
-        {
-            cout << "STB SUCCESS: " << path << " (" << width << "x" << height << ", " << nrComponents << " channels)" << endl;
-            unsigned int textureID;
-            glGenTextures(1, &textureID);
-            GLenum format;
-            if(nrComponents == 1) format = GL_RED;
-            else if(nrComponents == 3) format = GL_RGB;
-            else if(nrComponents == 4) format = GL_RGBA;
-
-            glBindTexture(GL_TEXTURE_2D, textureID);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-            stbi_image_free(data);
-            return textureID;
-        }
-        else
-        {
-            cout << "STB FAILED: " << path << endl;
-            stbi_image_free(data);
-            return 0;
-        }
-    }
-
 };
 
 #endif
\ No newline at end of file
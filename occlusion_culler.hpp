@@ -0,0 +1,274 @@
+#ifndef OCCLUSION_CULLER_HPP
+#define OCCLUSION_CULLER_HPP
+
+#include <glm/glm.hpp>
+#include <bounds.hpp>
+#include <mesh_optimizer.hpp>
+#include <thread_pool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OCCLUSION_SIMD 1
+#endif
+using namespace std;
+
+// Widths are multiples of four so a row never splits an SSE group across tiles.
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+#define OCCLUSION_TILE_WIDTH 64
+#define OCCLUSION_TILE_HEIGHT 32
+
+// CPU occlusion culling against a low-resolution depth buffer. Each frame: Begin with
+// the camera's viewProjection, AddOccluder for the few big objects worth it (their
+// OccluderMesh, not the render mesh), Rasterize, then ask IsVisible for the bounds of
+// everything else before submitting it. Depth is NDC z mapped to [0, 1], nearest kept.
+//
+// Triangles are binned into tiles when added and each tile is rasterized as its own
+// ParallelFor job, four pixels at a time with SSE2. Anything touching the near plane is
+// skipped as an occluder and reported visible as an occludee, so mistakes only ever
+// cost culling, not correctness.
+class OcclusionCuller
+{
+public:
+    OcclusionCuller() : depth(OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 1.0f), bins(tilesX * tilesY) {}
+
+    void Begin(const glm::mat4& viewProjection)
+    {
+        this->viewProjection = viewProjection;
+        triangles.clear();
+        for (vector<unsigned int>& bin : bins)
+            bin.clear();
+        fill(depth.begin(), depth.end(), 1.0f);
+    }
+
+    // Transforms and bins the occluder's triangles; nothing is drawn until Rasterize.
+    void AddOccluder(const OccluderMesh& occluder, const glm::mat4& model)
+    {
+        if (occluder.IsEmpty())
+            return;
+        glm::mat4 transform = viewProjection * model;
+        clip.resize(occluder.vertices.size());
+        for (size_t i = 0; i < occluder.vertices.size(); i++)
+            clip[i] = transform * glm::vec4(occluder.vertices[i], 1.0f);
+
+        for (size_t i = 0; i + 2 < occluder.indices.size(); i += 3)
+        {
+            const glm::vec4* corners[3] = { &clip[occluder.indices[i]], &clip[occluder.indices[i + 1]], &clip[occluder.indices[i + 2]] };
+            glm::vec3 screen[3];
+            bool clipped = false;
+            for (int v = 0; v < 3 && !clipped; v++)
+            {
+                const glm::vec4& c = *corners[v];
+                if (c.w <= 1e-5f || c.z < -c.w)
+                    clipped = true;
+                else
+                    screen[v] = toScreen(c);
+            }
+            if (!clipped)
+                addTriangle(screen[0], screen[1], screen[2]);
+        }
+    }
+
+    void Rasterize()
+    {
+        auto start = chrono::steady_clock::now();
+        if (!triangles.empty())
+            ParallelFor(bins.size(), [this](unsigned int tile) { rasterizeTile(tile); });
+        rasterizeMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // False only if every pixel the box covers has an occluder nearer than the box's
+    // nearest point.
+    bool IsVisible(const Bounds& bounds) const
+    {
+        if (triangles.empty() || bounds.IsEmpty())
+            return true;
+        float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearest = FLT_MAX;
+        for (int i = 0; i < 8; i++)
+        {
+            glm::vec3 corner((i & 1) ? bounds.max.x : bounds.min.x, (i & 2) ? bounds.max.y : bounds.min.y, (i & 4) ? bounds.max.z : bounds.min.z);
+            glm::vec4 c = viewProjection * glm::vec4(corner, 1.0f);
+            if (c.w <= 1e-5f || c.z < -c.w)
+                return true;
+            glm::vec3 screen = toScreen(c);
+            minX = min(minX, screen.x);
+            maxX = max(maxX, screen.x);
+            minY = min(minY, screen.y);
+            maxY = max(maxY, screen.y);
+            nearest = min(nearest, screen.z);
+        }
+        int x0 = max((int)floor(minX), 0), x1 = min((int)floor(maxX), OCCLUSION_WIDTH - 1);
+        int y0 = max((int)floor(minY), 0), y1 = min((int)floor(maxY), OCCLUSION_HEIGHT - 1);
+        // off screen is the frustum test's call
+        if (x0 > x1 || y0 > y1)
+            return true;
+
+#ifdef OCCLUSION_SIMD
+        // whole groups of four; the extra pixels can only make the box more visible
+        __m128 boxDepth = _mm_set1_ps(nearest);
+        for (int y = y0; y <= y1; y++)
+        {
+            const float* row = &depth[y * OCCLUSION_WIDTH];
+            for (int x = x0 & ~3; x <= x1; x += 4)
+            {
+                if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), boxDepth)))
+                    return true;
+            }
+        }
+#else
+        for (int y = y0; y <= y1; y++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                if (depth[y * OCCLUSION_WIDTH + x] >= nearest)
+                    return true;
+            }
+        }
+#endif
+        return false;
+    }
+
+    size_t GetTriangleCount() const { return triangles.size(); }
+    double GetRasterizeMs() const { return rasterizeMs; }
+    const vector<float>& GetDepth() const { return depth; }
+
+private:
+    static const int tilesX = OCCLUSION_WIDTH / OCCLUSION_TILE_WIDTH;
+    static const int tilesY = OCCLUSION_HEIGHT / OCCLUSION_TILE_HEIGHT;
+
+    // Edge functions e = a * x + b * y + c, non-negative inside, and the depth plane,
+    // all in pixel coordinates; plus the clamped pixel bounds.
+    struct ScreenTriangle
+    {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, minY, maxX, maxY;
+    };
+
+    glm::mat4 viewProjection = glm::mat4(1.0f);
+    vector<float> depth;
+    vector<ScreenTriangle> triangles;
+    vector<vector<unsigned int>> bins;
+    vector<glm::vec4> clip;
+    double rasterizeMs = 0.0;
+
+    static glm::vec3 toScreen(const glm::vec4& c)
+    {
+        float invW = 1.0f / c.w;
+        return glm::vec3((c.x * invW * 0.5f + 0.5f) * OCCLUSION_WIDTH, (c.y * invW * 0.5f + 0.5f) * OCCLUSION_HEIGHT, c.z * invW * 0.5f + 0.5f);
+    }
+
+    void addTriangle(glm::vec3 v0, glm::vec3 v1, glm::vec3 v2)
+    {
+        // occluders are double sided: wind everything counter-clockwise
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (fabs(area) < 1e-6f)
+            return;
+        if (area < 0.0f)
+        {
+            swap(v1, v2);
+            area = -area;
+        }
+        if (v0.z > 1.0f && v1.z > 1.0f && v2.z > 1.0f)
+            return;
+
+        ScreenTriangle triangle;
+        triangle.minX = max((int)floor(min(v0.x, min(v1.x, v2.x))), 0);
+        triangle.minY = max((int)floor(min(v0.y, min(v1.y, v2.y))), 0);
+        triangle.maxX = min((int)ceil(max(v0.x, max(v1.x, v2.x))), OCCLUSION_WIDTH - 1);
+        triangle.maxY = min((int)ceil(max(v0.y, max(v1.y, v2.y))), OCCLUSION_HEIGHT - 1);
+        if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+            return;
+
+        // edge i runs from vertex i to vertex i + 1 and weighs the vertex opposite it
+        const glm::vec3* v[3] = { &v0, &v1, &v2 };
+        for (int i = 0; i < 3; i++)
+        {
+            const glm::vec3& a = *v[i];
+            const glm::vec3& b = *v[(i + 1) % 3];
+            triangle.edgeA[i] = a.y - b.y;
+            triangle.edgeB[i] = b.x - a.x;
+            triangle.edgeC[i] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+        }
+        // edge 2 weighs v1 and edge 0 weighs v2, so z = z0 + (z1 - z0) e2 / area + (z2 - z0) e0 / area
+        float d1 = (v1.z - v0.z) / area;
+        float d2 = (v2.z - v0.z) / area;
+        triangle.depthA = d1 * triangle.edgeA[2] + d2 * triangle.edgeA[0];
+        triangle.depthB = d1 * triangle.edgeB[2] + d2 * triangle.edgeB[0];
+        triangle.depthC = v0.z + d1 * triangle.edgeC[2] + d2 * triangle.edgeC[0];
+
+        unsigned int index = triangles.size();
+        triangles.push_back(triangle);
+        for (int ty = triangle.minY / OCCLUSION_TILE_HEIGHT; ty <= triangle.maxY / OCCLUSION_TILE_HEIGHT; ty++)
+        {
+            for (int tx = triangle.minX / OCCLUSION_TILE_WIDTH; tx <= triangle.maxX / OCCLUSION_TILE_WIDTH; tx++)
+                bins[ty * tilesX + tx].push_back(index);
+        }
+    }
+
+    // Tiles own disjoint pixels, so they run in parallel without locking.
+    void rasterizeTile(unsigned int tile)
+    {
+        int tileX = (tile % tilesX) * OCCLUSION_TILE_WIDTH;
+        int tileY = (tile / tilesX) * OCCLUSION_TILE_HEIGHT;
+        for (unsigned int index : bins[tile])
+        {
+            const ScreenTriangle& t = triangles[index];
+            int x0 = max(t.minX, tileX) & ~3;
+            int x1 = min(t.maxX, tileX + OCCLUSION_TILE_WIDTH - 1);
+            int y0 = max(t.minY, tileY);
+            int y1 = min(t.maxY, tileY + OCCLUSION_TILE_HEIGHT - 1);
+#ifdef OCCLUSION_SIMD
+            __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+            __m128 zero = _mm_setzero_ps();
+            __m128 edgeA0 = _mm_set1_ps(t.edgeA[0]), edgeA1 = _mm_set1_ps(t.edgeA[1]), edgeA2 = _mm_set1_ps(t.edgeA[2]);
+            __m128 depthA = _mm_set1_ps(t.depthA);
+            for (int y = y0; y <= y1; y++)
+            {
+                float py = y + 0.5f;
+                __m128 rowE0 = _mm_set1_ps(t.edgeB[0] * py + t.edgeC[0]);
+                __m128 rowE1 = _mm_set1_ps(t.edgeB[1] * py + t.edgeC[1]);
+                __m128 rowE2 = _mm_set1_ps(t.edgeB[2] * py + t.edgeC[2]);
+                __m128 rowZ = _mm_set1_ps(t.depthB * py + t.depthC);
+                float* row = &depth[y * OCCLUSION_WIDTH];
+                for (int x = x0; x <= x1; x += 4)
+                {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                    __m128 e0 = _mm_add_ps(_mm_mul_ps(edgeA0, px), rowE0);
+                    __m128 e1 = _mm_add_ps(_mm_mul_ps(edgeA1, px), rowE1);
+                    __m128 e2 = _mm_add_ps(_mm_mul_ps(edgeA2, px), rowE2);
+                    __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+                    if (!_mm_movemask_ps(inside))
+                        continue;
+                    __m128 z = _mm_max_ps(_mm_add_ps(_mm_mul_ps(depthA, px), rowZ), zero);
+                    __m128 current = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(current, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+                }
+            }
+#else
+            for (int y = y0; y <= y1; y++)
+            {
+                float py = y + 0.5f;
+                for (int x = x0; x <= x1; x++)
+                {
+                    float px = x + 0.5f;
+                    if (t.edgeA[0] * px + t.edgeB[0] * py + t.edgeC[0] < 0.0f ||
+                        t.edgeA[1] * px + t.edgeB[1] * py + t.edgeC[1] < 0.0f ||
+                        t.edgeA[2] * px + t.edgeB[2] * py + t.edgeC[2] < 0.0f)
+                        continue;
+                    float z = max(t.depthA * px + t.depthB * py + t.depthC, 0.0f);
+                    float& current = depth[y * OCCLUSION_WIDTH + x];
+                    current = min(current, z);
+                }
+            }
+#endif
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,12 @@
+#version 330 core
+out vec4 FragColor;
+
+// Stand-in for a model that is still loading; pulses so it reads as "busy"
+uniform vec3 color;
+uniform float time;
+
+void main()
+{
+    float pulse = 0.6 + 0.4 * sin(time * 4.0);
+    FragColor = vec4(color * pulse, 1.0);
+}
@@ -0,0 +1,103 @@
+#ifndef POSE_CACHE_HPP
+#define POSE_CACHE_HPP
+
+#include <glm/glm.hpp>
+#include <model.hpp>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Shares evaluated bone palettes between instances of the same animated model.
+// Instance time is snapped to samplesPerSecond buckets, so every instance that
+// lands in the same (clip, bucket) reuses one skeleton evaluation. Entries stay
+// alive across frames and are only evicted once the cache grows past maxEntries.
+class PoseCache
+{
+public:
+    PoseCache(float samplesPerSecond = 30.0f, size_t maxEntries = 1024)
+        : samplesPerSecond(samplesPerSecond), maxEntries(maxEntries)
+    {
+    }
+
+    void BeginFrame()
+    {
+        frame++;
+        hits = 0;
+        misses = 0;
+        if (entries.size() <= maxEntries)
+            return;
+
+        for (auto it = entries.begin(); it != entries.end();)
+        {
+            if (it->second.lastUsedFrame + 1 < frame)
+                it = entries.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    // currentTime is the instance's own clock in seconds (phase and speed already applied).
+    // The returned palette stays valid until the next BeginFrame.
+    const vector<glm::mat4>& GetPose(Model& model, int clipIndex, float currentTime)
+    {
+        const AnimationClip& clip = model.GetAnimation(clipIndex);
+        float ticksPerBucket = clip.ticksPerSecond / samplesPerSecond;
+        uint32_t bucket = (uint32_t)(clip.GetAnimationTime(currentTime) / ticksPerBucket);
+
+        PoseKey key{ &clip, bucket };
+        auto it = entries.find(key);
+        if (it != entries.end())
+        {
+            hits++;
+            it->second.lastUsedFrame = frame;
+            return it->second.transforms;
+        }
+
+        misses++;
+        PoseEntry& entry = entries[key];
+        entry.lastUsedFrame = frame;
+        entry.transforms.assign(model.GetBoneCount(), glm::mat4(1.0f));
+        model.EvaluatePose(clipIndex, bucket * ticksPerBucket, cursors[&clip], entry.transforms);
+        return entry.transforms;
+    }
+
+    int GetHits() const { return hits; }
+    int GetMisses() const { return misses; }
+    size_t GetEntryCount() const { return entries.size(); }
+
+private:
+    struct PoseKey
+    {
+        const AnimationClip* clip;
+        uint32_t bucket;
+
+        bool operator==(const PoseKey& other) const { return clip == other.clip && bucket == other.bucket; }
+    };
+
+    struct PoseKeyHash
+    {
+        size_t operator()(const PoseKey& key) const
+        {
+            return hash<const void*>()(key.clip) ^ (hash<uint32_t>()(key.bucket) * 0x9e3779b97f4a7c15ull);
+        }
+    };
+
+    struct PoseEntry
+    {
+        vector<glm::mat4> transforms;
+        uint64_t lastUsedFrame = 0;
+    };
+
+    float samplesPerSecond;
+    size_t maxEntries;
+    uint64_t frame = 0;
+    int hits = 0;
+    int misses = 0;
+    unordered_map<PoseKey, PoseEntry, PoseKeyHash> entries;
+    unordered_map<const AnimationClip*, AnimationCursor> cursors;
+};
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef SCENE_BVH_HPP
+#define SCENE_BVH_HPP
+
+#include <glm/glm.hpp>
+#include <bounds.hpp>
+#include <frustum.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+#define BVH_LEAF_SIZE 4
+#define BVH_MAX_DEPTH 64
+
+// Bounding volume hierarchy over scene objects (troopers, props, ships). Objects are
+// axis-aligned boxes addressed by the id Insert returns. Moving objects call Update
+// and the tree is refitted bottom-up from just those leaves on the next query; adding
+// or removing objects, or refits that have bloated the tree, trigger a full rebuild.
+class SceneBVH
+{
+public:
+    int Insert(const Bounds& bounds)
+    {
+        int id;
+        if (!freeIds.empty())
+        {
+            id = freeIds.back();
+            freeIds.pop_back();
+            objects[id] = { bounds, true, -1 };
+        }
+        else
+        {
+            id = objects.size();
+            objects.push_back({ bounds, true, -1 });
+        }
+        liveCount++;
+        needsBuild = true;
+        return id;
+    }
+
+    void Remove(int id)
+    {
+        objects[id].alive = false;
+        freeIds.push_back(id);
+        liveCount--;
+        needsBuild = true;
+    }
+
+    void Update(int id, const Bounds& bounds)
+    {
+        objects[id].bounds = bounds;
+        if (!needsBuild)
+            dirty.push_back(id);
+    }
+
+    const Bounds& GetBounds(int id) const { return objects[id].bounds; }
+    int GetObjectCount() const { return liveCount; }
+    int GetNodeCount() const { return nodes.size(); }
+
+    // Brings the tree up to date; queries call this themselves.
+    void Refresh()
+    {
+        if (needsBuild)
+            build();
+        else if (!dirty.empty())
+            refit();
+    }
+
+    void Build()
+    {
+        needsBuild = true;
+        Refresh();
+    }
+
+    // Ids of objects whose box is at least partly inside the frustum.
+    void QueryFrustum(const Frustum& frustum, vector<int>& results)
+    {
+        Refresh();
+        results.clear();
+        if (nodes.empty())
+            return;
+
+        // a node fully inside a plane needs no further tests against it
+        pair<int, int> stack[BVH_MAX_DEPTH * 2];
+        int top = 0;
+        stack[top++] = { 0, 0x3f };
+        while (top > 0)
+        {
+            int index = stack[top - 1].first;
+            int planes = stack[top - 1].second;
+            top--;
+            const Node& node = nodes[index];
+
+            glm::vec3 center = (node.min + node.max) * 0.5f;
+            glm::vec3 extents = (node.max - node.min) * 0.5f;
+            bool outside = false;
+            for (int p = 0; p < 6 && !outside; p++)
+            {
+                if (!(planes & (1 << p)))
+                    continue;
+                glm::vec3 normal = glm::vec3(frustum.planes[p]);
+                float distance = glm::dot(normal, center) + frustum.planes[p].w;
+                float reach = glm::dot(glm::abs(normal), extents);
+                if (distance < -reach)
+                    outside = true;
+                else if (distance >= reach)
+                    planes &= ~(1 << p);
+            }
+            if (outside)
+                continue;
+
+            if (node.count > 0)
+            {
+                for (int i = node.first; i < node.first + node.count; i++)
+                {
+                    if (planes == 0 || frustum.TestBox(objects[order[i]].bounds))
+                        results.push_back(order[i]);
+                }
+            }
+            else if (planes == 0)
+                collect(index, results);
+            else
+            {
+                stack[top++] = { node.right, planes };
+                stack[top++] = { node.left, planes };
+            }
+        }
+    }
+
+    // Ids of objects whose box overlaps the sphere.
+    void QuerySphere(const glm::vec3& center, float radius, vector<int>& results)
+    {
+        Refresh();
+        results.clear();
+        float radiusSquared = radius * radius;
+        traverse([&](const glm::vec3& min, const glm::vec3& max)
+        {
+            glm::vec3 d = center - glm::clamp(center, min, max);
+            return glm::dot(d, d) <= radiusSquared;
+        }, results);
+    }
+
+    // Ids of objects whose box overlaps bounds.
+    void QueryBox(const Bounds& bounds, vector<int>& results)
+    {
+        Refresh();
+        results.clear();
+        traverse([&](const glm::vec3& min, const glm::vec3& max)
+        {
+            return min.x <= bounds.max.x && max.x >= bounds.min.x &&
+                   min.y <= bounds.max.y && max.y >= bounds.min.y &&
+                   min.z <= bounds.max.z && max.z >= bounds.min.z;
+        }, results);
+    }
+
+private:
+    struct Object
+    {
+        Bounds bounds;
+        bool alive;
+        int leaf;
+    };
+
+    // Interior nodes have count 0 and two children; leaves list order[first, first + count).
+    struct Node
+    {
+        glm::vec3 min, max;
+        int parent;
+        int left, right;
+        int first, count;
+    };
+
+    vector<Object> objects;
+    vector<int> freeIds;
+    vector<int> order;
+    vector<Node> nodes;
+    vector<int> dirty;
+    int liveCount = 0;
+    bool needsBuild = false;
+    float builtArea = 0.0f;
+
+    static float surfaceArea(const glm::vec3& min, const glm::vec3& max)
+    {
+        glm::vec3 size = max - min;
+        return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+    }
+
+    void build()
+    {
+        needsBuild = false;
+        dirty.clear();
+        nodes.clear();
+        order.clear();
+        for (int id = 0; id < (int)objects.size(); id++)
+        {
+            if (objects[id].alive)
+                order.push_back(id);
+        }
+        if (order.empty())
+            return;
+        nodes.reserve(order.size() / BVH_LEAF_SIZE * 2 + 1);
+        buildNode(-1, 0, order.size(), 0);
+        builtArea = surfaceArea(nodes[0].min, nodes[0].max);
+    }
+
+    // Median split on the longest axis of the centroid bounds; depth-first so every
+    // child comes after its parent in nodes.
+    int buildNode(int parent, int first, int count, int depth)
+    {
+        int index = nodes.size();
+        nodes.push_back(Node());
+        Node node;
+        node.parent = parent;
+        node.left = node.right = -1;
+        node.first = first;
+        node.count = 0;
+        node.min = glm::vec3(FLT_MAX);
+        node.max = glm::vec3(-FLT_MAX);
+        Bounds centroids;
+        for (int i = first; i < first + count; i++)
+        {
+            const Bounds& bounds = objects[order[i]].bounds;
+            node.min = glm::min(node.min, bounds.min);
+            node.max = glm::max(node.max, bounds.max);
+            centroids.Expand(bounds.GetCenter());
+        }
+
+        if (count <= BVH_LEAF_SIZE || depth >= BVH_MAX_DEPTH - 1)
+        {
+            node.count = count;
+            for (int i = first; i < first + count; i++)
+                objects[order[i]].leaf = index;
+            nodes[index] = node;
+            return index;
+        }
+
+        glm::vec3 size = centroids.max - centroids.min;
+        int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+        int half = count / 2;
+        nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, [&](int a, int b)
+        {
+            return objects[a].bounds.GetCenter()[axis] < objects[b].bounds.GetCenter()[axis];
+        });
+
+        node.left = buildNode(index, first, half, depth + 1);
+        node.right = buildNode(index, first + half, count - half, depth + 1);
+        nodes[index] = node;
+        return index;
+    }
+
+    // Recomputes the leaves of moved objects and walks up while boxes keep changing.
+    void refit()
+    {
+        for (int id : dirty)
+        {
+            int index = objects[id].leaf;
+            while (index >= 0)
+            {
+                Node& node = nodes[index];
+                glm::vec3 min(FLT_MAX), max(-FLT_MAX);
+                if (node.count > 0)
+                {
+                    for (int i = node.first; i < node.first + node.count; i++)
+                    {
+                        min = glm::min(min, objects[order[i]].bounds.min);
+                        max = glm::max(max, objects[order[i]].bounds.max);
+                    }
+                }
+                else
+                {
+                    min = glm::min(nodes[node.left].min, nodes[node.right].min);
+                    max = glm::max(nodes[node.left].max, nodes[node.right].max);
+                }
+                if (min == node.min && max == node.max)
+                    break;
+                node.min = min;
+                node.max = max;
+                index = node.parent;
+            }
+        }
+        dirty.clear();
+
+        // objects that drifted apart leave a tree of large overlapping nodes
+        if (surfaceArea(nodes[0].min, nodes[0].max) > builtArea * 4.0f)
+            build();
+    }
+
+    void collect(int index, vector<int>& results) const
+    {
+        int stack[BVH_MAX_DEPTH * 2];
+        int top = 0;
+        stack[top++] = index;
+        while (top > 0)
+        {
+            const Node& node = nodes[stack[--top]];
+            if (node.count > 0)
+            {
+                for (int i = node.first; i < node.first + node.count; i++)
+                    results.push_back(order[i]);
+            }
+            else
+            {
+                stack[top++] = node.right;
+                stack[top++] = node.left;
+            }
+        }
+    }
+
+    template <typename Overlaps>
+    void traverse(Overlaps overlaps, vector<int>& results) const
+    {
+        if (nodes.empty())
+            return;
+        int stack[BVH_MAX_DEPTH * 2];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0)
+        {
+            const Node& node = nodes[stack[--top]];
+            if (!overlaps(node.min, node.max))
+                continue;
+            if (node.count > 0)
+            {
+                for (int i = node.first; i < node.first + node.count; i++)
+                {
+                    const Bounds& bounds = objects[order[i]].bounds;
+                    if (overlaps(bounds.min, bounds.max))
+                        results.push_back(order[i]);
+                }
+            }
+            else
+            {
+                stack[top++] = node.right;
+                stack[top++] = node.left;
+            }
+        }
+    }
+};
+
+#endif
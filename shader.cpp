@@ -1,4 +1,10 @@
 #include "shader.hpp"
+#include "gl_state.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
 
 std::string readShaderSource(const char* path)
 {
@@ -30,7 +36,7 @@ unsigned int compileShader(unsigned int type , const char* shaderSource)
     return id;
 }
 
-void manageShader(unsigned int &ID, unsigned int vertex, unsigned int fragment)
+bool manageShader(unsigned int &ID, unsigned int vertex, unsigned int fragment)
 {
     int linksuccess;
     char infoLog[512];
@@ -38,6 +44,7 @@ void manageShader(unsigned int &ID, unsigned int vertex, unsigned int fragment)
     ID = glCreateProgram();
     glAttachShader(ID,vertex);
     glAttachShader(ID,fragment);
+    glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(ID);
 
     glGetProgramiv(ID , GL_LINK_STATUS , &linksuccess);
@@ -49,6 +56,124 @@ void manageShader(unsigned int &ID, unsigned int vertex, unsigned int fragment)
     
     glDeleteShader(vertex);
     glDeleteShader(fragment);
+    return linksuccess;
+}
+
+bool manageComputeShader(unsigned int &ID, unsigned int compute)
+{
+    int linksuccess;
+    char infoLog[512];
+
+    ID = glCreateProgram();
+    glAttachShader(ID, compute);
+    glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(ID);
+
+    glGetProgramiv(ID, GL_LINK_STATUS, &linksuccess);
+    if (!linksuccess)
+    {
+        glGetProgramInfoLog(ID, 512, NULL, infoLog);
+        std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    }
+
+    glDeleteShader(compute);
+    return linksuccess;
+}
+
+// Program binary cache. Entries are keyed by a hash of both sources plus the
+// driver strings, since a binary is only valid for the driver that produced it.
+const char* SHADER_CACHE_DIR = "shader_cache";
+const char SHADER_CACHE_MAGIC[4] = { 'C', 'D', 'S', 'B' };
+
+std::string programCacheKey(const std::string& vShaderSource, const std::string& fShaderSource)
+{
+    unsigned long long hash = 1469598103934665603ull; // FNV-1a
+    auto mix = [&hash](const char* data, size_t size)
+    {
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= (unsigned char)data[i];
+            hash *= 1099511628211ull;
+        }
+        hash ^= 0xff; // separator so "ab"+"c" and "a"+"bc" differ
+        hash *= 1099511628211ull;
+    };
+    mix(vShaderSource.data(), vShaderSource.size());
+    mix(fShaderSource.data(), fShaderSource.size());
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION })
+    {
+        const char* value = (const char*)glGetString(name);
+        if (value)
+            mix(value, strlen(value));
+    }
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", hash);
+    return key;
+}
+
+bool programBinarySupported()
+{
+    int formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+bool loadProgramBinary(unsigned int &ID, const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+
+    char magic[4];
+    GLenum format = 0;
+    unsigned int length = 0;
+    file.read(magic, 4);
+    file.read((char*)&format, sizeof(format));
+    file.read((char*)&length, sizeof(length));
+    if (!file || memcmp(magic, SHADER_CACHE_MAGIC, 4) != 0 || length == 0)
+        return false;
+
+    std::vector<char> binary(length);
+    if (!file.read(binary.data(), length))
+        return false;
+
+    ID = glCreateProgram();
+    glProgramBinary(ID, format, binary.data(), length);
+    int linksuccess;
+    glGetProgramiv(ID, GL_LINK_STATUS, &linksuccess);
+    if (!linksuccess)
+    {
+        // driver update or corrupt entry; caller recompiles and overwrites it
+        std::cout << "DEBUG: Shader cache entry " << path << " rejected by driver" << std::endl;
+        glDeleteProgram(ID);
+        ID = 0;
+        return false;
+    }
+    return true;
+}
+
+void saveProgramBinary(unsigned int ID, const std::string& path)
+{
+    int length = 0;
+    glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(ID, length, NULL, &format, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(SHADER_CACHE_DIR, error);
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+        return;
+    unsigned int size = length;
+    file.write(SHADER_CACHE_MAGIC, 4);
+    file.write((const char*)&format, sizeof(format));
+    file.write((const char*)&size, sizeof(size));
+    file.write(binary.data(), length);
 }
 
 Shader::Shader(const char* vertexPath, const char* fragmentPath)
@@ -56,43 +181,214 @@ Shader::Shader(const char* vertexPath, const char* fragmentPath)
     std::string vShaderSource = readShaderSource(vertexPath);
     std::string fShaderSource = readShaderSource(fragmentPath);
 
+    bool useCache = programBinarySupported();
+    std::string cachePath = std::string(SHADER_CACHE_DIR) + "/" + programCacheKey(vShaderSource, fShaderSource) + ".bin";
+    if (useCache && loadProgramBinary(ID, cachePath))
+    {
+        std::cout << "DEBUG: Loaded " << vertexPath << " + " << fragmentPath << " from shader cache" << std::endl;
+        bindUniformBlocks();
+        reflectUniforms();
+        bindSamplerUnits();
+        return;
+    }
+
     unsigned int vertex = compileShader(GL_VERTEX_SHADER , vShaderSource.c_str());
     unsigned int fragment = compileShader(GL_FRAGMENT_SHADER , fShaderSource.c_str());
 
-    manageShader(ID,vertex,fragment);
+    if (manageShader(ID,vertex,fragment) && useCache)
+        saveProgramBinary(ID, cachePath);
+    bindUniformBlocks();
+    reflectUniforms();
+    bindSamplerUnits();
+}
+
+Shader::Shader(const char* computePath)
+{
+    std::string cShaderSource = readShaderSource(computePath);
+
+    bool useCache = programBinarySupported();
+    std::string cachePath = std::string(SHADER_CACHE_DIR) + "/" + programCacheKey(cShaderSource, "") + ".bin";
+    if (useCache && loadProgramBinary(ID, cachePath))
+    {
+        std::cout << "DEBUG: Loaded " << computePath << " from shader cache" << std::endl;
+        bindUniformBlocks();
+        reflectUniforms();
+        return;
+    }
+
+    unsigned int compute = compileShader(GL_COMPUTE_SHADER, cShaderSource.c_str());
+    if (manageComputeShader(ID, compute) && useCache)
+        saveProgramBinary(ID, cachePath);
+    bindUniformBlocks();
+    reflectUniforms();
 }
 
 void Shader::use()
 {
-    glUseProgram(ID);
+    GetGLState().UseProgram(ID);
+}
+
+void Shader::bindUniformBlocks()
+{
+    static const struct { const char* name; unsigned int binding; } blocks[] = {
+        { "FrameData", FRAME_UNIFORMS_BINDING },
+        { "MaterialData", MATERIAL_UNIFORMS_BINDING },
+    };
+    for (const auto& block : blocks)
+    {
+        unsigned int index = glGetUniformBlockIndex(ID, block.name);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, block.binding);
+    }
+}
+
+// Two units per texture type; unit 8 and up stay free for per-draw textures like the baked bone texture.
+static const struct { const char* type; int firstUnit; } materialSamplers[] = {
+    { "texture_diffuse", 0 },
+    { "texture_normal", 2 },
+    { "texture_height", 4 },
+    { "texture_specular", 6 },
+};
+
+int materialTextureUnit(const std::string& type, unsigned int number)
+{
+    if (number < 1 || number > 2)
+        return -1;
+    for (const auto& sampler : materialSamplers)
+    {
+        if (type == sampler.type)
+            return sampler.firstUnit + number - 1;
+    }
+    return -1;
+}
+
+// Sampler values are program state, so this only has to happen once per program.
+void Shader::bindSamplerUnits()
+{
+    for (const auto& sampler : materialSamplers)
+    {
+        for (unsigned int number = 1; number <= 2; number++)
+        {
+            int location = GetUniformLocation(sampler.type + std::to_string(number));
+            if (location != -1)
+                glProgramUniform1i(ID, location, sampler.firstUnit + number - 1);
+        }
+    }
+}
+
+void Shader::reflectUniforms()
+{
+    int count = 0;
+    int maxLength = 0;
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::string name(maxLength, '\0');
+    for (int i = 0; i < count; i++)
+    {
+        int length = 0;
+        int size = 0;
+        GLenum type;
+        glGetActiveUniform(ID, i, maxLength, &length, &size, &type, &name[0]);
+        std::string uniformName = name.substr(0, length);
+
+        int location = glGetUniformLocation(ID, uniformName.c_str());
+        if (location < 0)
+            continue; // lives in a uniform block
+
+        uniformLocations[uniformName] = location;
+        // arrays are reported as "name[0]"; register the bare name and every element too
+        size_t bracket = uniformName.rfind("[0]");
+        if (bracket != std::string::npos && bracket + 3 == uniformName.size())
+        {
+            std::string baseName = uniformName.substr(0, bracket);
+            uniformLocations[baseName] = location;
+            for (int element = 1; element < size; element++)
+            {
+                std::string elementName = baseName + "[" + std::to_string(element) + "]";
+                uniformLocations[elementName] = glGetUniformLocation(ID, elementName.c_str());
+            }
+        }
+    }
+    drawBase = GetUniform<int>("drawBase");
+}
+
+int Shader::GetUniformLocation(const std::string& name) const
+{
+    auto it = uniformLocations.find(name);
+    if (it != uniformLocations.end())
+        return it->second;
+    // every active uniform was reflected at link time, so anything else is inactive
+    uniformLocations[name] = -1;
+    return -1;
 }
 
 void Shader::setBool(const std::string& name , bool value) const
 {
-    glUniform1i(glGetUniformLocation(ID , name.c_str()) , (int)value);
+    glUniform1i(GetUniformLocation(name) , (int)value);
 }
 
 void Shader::setInt(const std::string& name , int value) const
 {
-    glUniform1i(glGetUniformLocation(ID , name.c_str()) , value);
+    glUniform1i(GetUniformLocation(name) , value);
 }
 
 void Shader::setFloat(const std::string& name, float value) const
 {
-    glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    glUniform1f(GetUniformLocation(name), value);
 }
 
 void Shader::setMat4(const std::string& name, const glm::mat4& mat) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+    glUniformMatrix4fv(GetUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
 }
 
 void Shader::setVec3(const std::string& name, const glm::vec3& value) const
 {
-    glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform3fv(GetUniformLocation(name), 1, &value[0]);
 }
 
 void Shader::setVec2(const std::string& name, const glm::vec2& value) const
 {
-    glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    glUniform2fv(GetUniformLocation(name), 1, &value[0]);
+}
+
+void Shader::setVec4(const std::string& name, const glm::vec4& value) const
+{
+    glUniform4fv(GetUniformLocation(name), 1, &value[0]);
+}
+
+void Shader::setBool(Uniform<bool> uniform, bool value) const
+{
+    glUniform1i(uniform.location, (int)value);
+}
+
+void Shader::setInt(Uniform<int> uniform, int value) const
+{
+    glUniform1i(uniform.location, value);
+}
+
+void Shader::setFloat(Uniform<float> uniform, float value) const
+{
+    glUniform1f(uniform.location, value);
+}
+
+void Shader::setMat4(Uniform<glm::mat4> uniform, const glm::mat4& mat) const
+{
+    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+}
+
+void Shader::setVec3(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+{
+    glUniform3fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::setVec2(Uniform<glm::vec2> uniform, const glm::vec2& value) const
+{
+    glUniform2fv(uniform.location, 1, &value[0]);
+}
+
+void Shader::setVec4(Uniform<glm::vec4> uniform, const glm::vec4& value) const
+{
+    glUniform4fv(uniform.location, 1, &value[0]);
 }
@@ -4,35 +4,47 @@ out vec4 FragColor;
 in vec2 TexCoords;
 in vec3 FragPos;
 in vec3 Normal;
+flat in int HasTexture;
 
 uniform sampler2D texture_diffuse1;
-uniform bool hasTexture;
 
-uniform vec3 lightPos;
-uniform vec3 viewPos;
-uniform vec3 lightColor;
+// Shared per-frame camera and light state (FrameUniforms)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+// Constants of the bound Material
+layout (std140) uniform MaterialData
+{
+    vec4 baseColor;
+};
 
 void main()
 {    
-    vec4 texColor = hasTexture ? texture(texture_diffuse1, TexCoords) : vec4(0.8, 0.5, 0.2, 1.0);
+    vec4 texColor = HasTexture != 0 ? texture(texture_diffuse1, TexCoords) : baseColor;
     if(texColor.a < 0.1) discard;
 
     // Ambient
     float ambientStrength = 0.1;
-    vec3 ambient = ambientStrength * lightColor;
+    vec3 ambient = ambientStrength * lightColor.xyz;
   	
     // Diffuse 
     vec3 norm = normalize(Normal);
-    vec3 lightDir = normalize(lightPos - FragPos);
+    vec3 lightDir = normalize(lightPos.xyz - FragPos);
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuse = diff * lightColor;
+    vec3 diffuse = diff * lightColor.xyz;
     
     // Specular
     float specularStrength = 0.5;
-    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 viewDir = normalize(viewPos.xyz - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);  
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
-    vec3 specular = specularStrength * spec * lightColor;  
+    vec3 specular = specularStrength * spec * lightColor.xyz;  
         
     vec3 result = (ambient + diffuse + specular) * texColor.rgb;
     FragColor = vec4(result, texColor.a);
@@ -8,19 +8,64 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+
+// Fixed binding points for engine-wide uniform blocks; Shader binds them after linking.
+#define FRAME_UNIFORMS_BINDING 0
+#define MATERIAL_UNIFORMS_BINDING 1
+
+// Fixed texture unit for a material sampler ("texture_diffuse", 1 -> texture_diffuse1),
+// or -1 if the sampler has none. Shader points its samplers at these units after linking.
+int materialTextureUnit(const std::string& type, unsigned int number);
+
+// A uniform location resolved once. The type parameter only exists so a handle
+// can't be passed to the wrong set* overload.
+template <typename T>
+struct Uniform
+{
+    int location = -1;
+};
 
 class Shader
 {
 public:
     unsigned int ID;
     Shader(const char* vertexPath, const char* fragmentPath);
+    // Compute program; run it with use() and glDispatchCompute
+    explicit Shader(const char* computePath);
     void use();
+
+    int GetUniformLocation(const std::string& name) const;
+    template <typename T>
+    Uniform<T> GetUniform(const std::string& name) const { return Uniform<T>{ GetUniformLocation(name) }; }
+
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
     void setFloat(const std::string& name, float value) const;
     void setMat4(const std::string& name, const glm::mat4& mat) const;
     void setVec3(const std::string& name, const glm::vec3& value) const;
     void setVec2(const std::string& name, const glm::vec2& value) const;
+    void setVec4(const std::string& name, const glm::vec4& value) const;
+
+    void setBool(Uniform<bool> uniform, bool value) const;
+    void setInt(Uniform<int> uniform, int value) const;
+    void setFloat(Uniform<float> uniform, float value) const;
+    void setMat4(Uniform<glm::mat4> uniform, const glm::mat4& mat) const;
+    void setVec3(Uniform<glm::vec3> uniform, const glm::vec3& value) const;
+    void setVec2(Uniform<glm::vec2> uniform, const glm::vec2& value) const;
+    void setVec4(Uniform<glm::vec4> uniform, const glm::vec4& value) const;
+
+    // First command of the current multi-draw batch (geometry_pool.hpp); resolved at link time
+    // because Model sets it for every batch it submits.
+    Uniform<int> GetDrawBase() const { return drawBase; }
+
+private:
+    Uniform<int> drawBase;
+    // Filled from glGetActiveUniform after linking; names that aren't active are cached as -1.
+    mutable std::unordered_map<std::string, int> uniformLocations;
+    void reflectUniforms();
+    void bindUniformBlocks();
+    void bindSamplerUnits();
 };
 
 #endif
\ No newline at end of file
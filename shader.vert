@@ -1,43 +1,74 @@
-#version 330 core
+#version 430 core
+#extension GL_ARB_shader_draw_parameters : require
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 layout (location = 5) in ivec4 boneIds; 
 layout (location = 6) in vec4 weights;
+layout (location = 7) in mat4 instanceModel;
+layout (location = 11) in int instancePalette;
 
 out vec2 TexCoords;
 out vec3 FragPos;
 out vec3 Normal;
+flat out int HasTexture;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// Shared per-frame camera and light state (FrameUniforms)
+layout (std140) uniform FrameData
+{
+    mat4 projection;
+    mat4 view;
+    vec4 viewPos;
+    vec4 lightPos;
+    vec4 lightColor;
+};
+
+// Per-draw data of the current multi-draw (MultiDrawBuffer); drawBase is the batch's first command
+struct DrawData
+{
+    int hasTexture;
+    int padding[3];
+};
+layout (std430, binding = 1) readonly buffer DrawParameters
+{
+    DrawData draws[];
+};
+uniform int drawBase;
 
-const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
-uniform mat4 finalBonesMatrices[MAX_BONES];
+
+// All palettes of the frame back to back (BonePaletteBuffer)
+layout (std430, binding = 0) readonly buffer BonePalettes
+{
+    mat4 finalBonesMatrices[];
+};
+uniform int bonesPerPalette;
 
 void main()
 {
+    int paletteBase = instancePalette * bonesPerPalette;
     vec4 totalPosition = vec4(0.0f);
     vec3 totalNormal = vec3(0.0f);
     for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
     {
         if(boneIds[i] == -1) 
             continue;
-        if(boneIds[i] >= MAX_BONES) 
+        if(boneIds[i] >= bonesPerPalette) 
         {
             totalPosition = vec4(aPos,1.0f);
             totalNormal = aNormal;
             break;
         }
-        vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(aPos,1.0f);
+        mat4 boneMatrix = finalBonesMatrices[paletteBase + boneIds[i]];
+        vec4 localPosition = boneMatrix * vec4(aPos,1.0f);
         totalPosition += localPosition * weights[i];
         
-        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * aNormal;
+        vec3 localNormal = mat3(boneMatrix) * aNormal;
         totalNormal += localNormal * weights[i];
     }
 	
+    mat4 model = instanceModel;
+    HasTexture = draws[drawBase + gl_DrawIDARB].hasTexture;
     TexCoords = aTexCoords;    
     FragPos = vec3(model * totalPosition);
     Normal = mat3(transpose(inverse(model))) * totalNormal;
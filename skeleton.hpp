@@ -0,0 +1,107 @@
+#ifndef SKELETON_HPP
+#define SKELETON_HPP
+
+#include <assimp/scene.h>
+#include <glm/glm.hpp>
+#include <assimp_glm_helpers.hpp>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+struct BoneInfo
+{
+    int id;
+    glm::mat4 offset;
+};
+
+// The node hierarchy flattened so that every parent comes before its children.
+// Everything pose evaluation needs is in these arrays; the aiScene can be dropped after Build.
+class Skeleton
+{
+public:
+    vector<string> names;
+    vector<int> parents;
+    vector<glm::mat4> bindLocal;
+    vector<glm::mat4> offsets;
+    vector<int> boneIds;
+
+    void Build(const aiNode* root, const map<string, BoneInfo>& boneInfoMap)
+    {
+        names.clear();
+        parents.clear();
+        bindLocal.clear();
+        offsets.clear();
+        boneIds.clear();
+        nodeLookup.clear();
+
+        vector<pair<const aiNode*, int>> stack;
+        stack.push_back({ root, -1 });
+        while (!stack.empty())
+        {
+            const aiNode* node = stack.back().first;
+            int parent = stack.back().second;
+            stack.pop_back();
+
+            int index = names.size();
+            string nodeName(node->mName.C_Str());
+            names.push_back(nodeName);
+            parents.push_back(parent);
+            bindLocal.push_back(AssimpGLMHelpers::ConvertMatrixToGLMFormat(node->mTransformation));
+            nodeLookup[nodeName] = index;
+
+            auto bone = boneInfoMap.find(nodeName);
+            if (bone != boneInfoMap.end())
+            {
+                boneIds.push_back(bone->second.id);
+                offsets.push_back(bone->second.offset);
+            }
+            else
+            {
+                boneIds.push_back(-1);
+                offsets.push_back(glm::mat4(1.0f));
+            }
+
+            // pushed in reverse so children are visited in their original order
+            for (int i = (int)node->mNumChildren - 1; i >= 0; i--)
+                stack.push_back({ node->mChildren[i], index });
+        }
+    }
+
+    // For skeletons filled in directly (cooked models) rather than through Build.
+    void RebuildLookup()
+    {
+        nodeLookup.clear();
+        for (size_t i = 0; i < names.size(); i++)
+            nodeLookup[names[i]] = i;
+    }
+
+    int GetNodeCount() const { return parents.size(); }
+
+    int FindNode(const string& name) const
+    {
+        auto it = nodeLookup.find(name);
+        return it != nodeLookup.end() ? it->second : -1;
+    }
+
+    // Single linear local-to-model pass. globalPose is caller-owned scratch so nothing is allocated per frame.
+    void ComputeBoneTransforms(const vector<glm::mat4>& localPose, vector<glm::mat4>& globalPose, vector<glm::mat4>& transforms) const
+    {
+        globalPose.resize(parents.size());
+        for (size_t i = 0; i < parents.size(); i++)
+        {
+            int parent = parents[i];
+            globalPose[i] = parent < 0 ? localPose[i] : globalPose[parent] * localPose[i];
+
+            int boneId = boneIds[i];
+            if (boneId >= 0 && boneId < (int)transforms.size())
+                transforms[boneId] = globalPose[i] * offsets[i];
+        }
+    }
+
+private:
+    unordered_map<string, int> nodeLookup;
+};
+
+#endif
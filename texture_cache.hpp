@@ -0,0 +1,280 @@
+#ifndef TEXTURE_CACHE_HPP
+#define TEXTURE_CACHE_HPP
+
+#include <glad/glad.h>
+#include <gl_state.hpp>
+#include <thread_pool.hpp>
+#define STB_IMAGE_IMPLEMENTATION
+#include <libraries/assimp/contrib/stb/stb_image.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+using namespace std;
+
+// Sampler and upload settings a cached texture was created with; part of the cache key.
+struct TextureSettings
+{
+    GLint wrap = GL_REPEAT;
+    GLint minFilter = GL_LINEAR_MIPMAP_LINEAR;
+    GLint magFilter = GL_LINEAR;
+    bool mipmaps = true;
+};
+
+// Process-wide cache of 2D textures loaded from disk. Each image is decoded and
+// uploaded once per (canonical path, settings); every Acquire adds a reference and
+// the texture is deleted when the last one is released. Missing paths are remembered
+// too, so fallback chains don't hit the disk again.
+//
+// Decoding runs on the thread pool. Acquire hands out the texture name right away;
+// the pixels arrive later through PumpUploads (or Flush), which allocates immutable
+// storage and uploads through a pixel buffer object on the GL thread. Until then
+// (or for good, if decoding fails) Resolve maps the name to a grey fallback texture.
+class TextureCache
+{
+public:
+    TextureCache(const TextureCache&) = delete;
+    TextureCache& operator=(const TextureCache&) = delete;
+
+    static TextureCache& Get()
+    {
+        static TextureCache* cache = new TextureCache();
+        return *cache;
+    }
+
+    // Returns 0 if the image can't be loaded.
+    unsigned int Acquire(const string& path, const TextureSettings& settings = TextureSettings())
+    {
+        string key = makeKey(path, settings);
+        auto it = entries.find(key);
+        if (it != entries.end())
+        {
+            it->second.references++;
+            hits++;
+            return it->second.id;
+        }
+        if (failed.count(key))
+            return 0;
+
+        // decode failures of files that exist only show up later, as an empty texture
+        error_code error;
+        if (!filesystem::is_regular_file(path, error))
+        {
+            cout << "STB FAILED: " << path << " (no such file)" << endl;
+            failed.insert(key);
+            return 0;
+        }
+
+        misses++;
+        unsigned int id;
+        glGenTextures(1, &id);
+        // GL recycles deleted names, so the decode is matched to this request, not just the name
+        unsigned int request = ++requests;
+        entries[key] = { id, 1, request };
+        keys[id] = key;
+
+        pending++;
+        placeholders.insert(id);
+        GetThreadPool().Submit([this, id, request, path, settings]
+        {
+            DecodedImage image;
+            image.id = id;
+            image.request = request;
+            image.path = path;
+            image.settings = settings;
+            image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0);
+            decoded.Push(image);
+        });
+        return id;
+    }
+
+    // Uploads whatever has finished decoding. Call once per frame on the GL thread.
+    void PumpUploads()
+    {
+        DecodedImage image;
+        while (decoded.TryPop(image))
+        {
+            upload(image);
+            pending--;
+        }
+    }
+
+    // Blocks until every submitted texture is decoded and uploaded.
+    void Flush()
+    {
+        while (pending > 0)
+        {
+            PumpUploads();
+            if (pending > 0)
+                this_thread::sleep_for(chrono::microseconds(200));
+        }
+    }
+
+    int GetPendingCount() const { return pending; }
+
+    // The texture to actually bind for id: id itself once its pixels are uploaded,
+    // the fallback while it is still decoding or if it failed.
+    unsigned int Resolve(unsigned int id)
+    {
+        if (placeholders.empty() || !placeholders.count(id))
+            return id;
+        return getFallback();
+    }
+
+    bool IsResident(unsigned int id) const { return id != 0 && keys.count(id) && !placeholders.count(id); }
+    // The file existed but could not be decoded; the name keeps resolving to the fallback.
+    bool IsFailed(unsigned int id) const { return decodeFailed.count(id) > 0; }
+
+    void Release(unsigned int id)
+    {
+        auto key = keys.find(id);
+        if (key == keys.end())
+            return;
+        auto it = entries.find(key->second);
+        if (--it->second.references > 0)
+            return;
+
+        GetGLState().ForgetTexture(id);
+        glDeleteTextures(1, &id);
+        placeholders.erase(id);
+        decodeFailed.erase(id);
+        entries.erase(it);
+        keys.erase(key);
+    }
+
+    size_t GetTextureCount() const { return entries.size(); }
+    unsigned int GetHits() const { return hits; }
+    unsigned int GetMisses() const { return misses; }
+
+private:
+    struct Entry
+    {
+        unsigned int id;
+        unsigned int references;
+        // the Acquire that created the texture, echoed back by its decode
+        unsigned int request;
+    };
+
+    unordered_map<string, Entry> entries;
+    unordered_map<unsigned int, string> keys;
+    unordered_set<string> failed;
+    // names handed out whose pixels are not (or never will be) uploaded
+    unordered_set<unsigned int> placeholders;
+    unordered_set<unsigned int> decodeFailed;
+    unsigned int fallback = 0;
+    unsigned int requests = 0;
+    unsigned int hits = 0;
+    unsigned int misses = 0;
+
+    struct DecodedImage
+    {
+        unsigned int id = 0;
+        unsigned int request = 0;
+        string path;
+        TextureSettings settings;
+        unsigned char* pixels = nullptr;
+        int width = 0, height = 0, channels = 0;
+    };
+    MPSCQueue<DecodedImage> decoded;
+    int pending = 0;
+    unsigned int PBO = 0;
+
+    TextureCache() {}
+
+    static string makeKey(const string& path, const TextureSettings& settings)
+    {
+        error_code error;
+        filesystem::path canonical = filesystem::weakly_canonical(path, error);
+        string key = error ? path : canonical.string();
+        return key + "|" + to_string(settings.wrap) + "," + to_string(settings.minFilter) + "," + to_string(settings.magFilter) + "," + (settings.mipmaps ? "1" : "0");
+    }
+
+    unsigned int getFallback()
+    {
+        if (fallback == 0)
+        {
+            unsigned char grey[4] = { 128, 128, 128, 255 };
+            glGenTextures(1, &fallback);
+            GetGLState().BindTexture(0, fallback);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, 1, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+        return fallback;
+    }
+
+    // The texture this decode was for, or nullptr if it was released in the meantime
+    // (its name may already belong to a newer texture).
+    Entry* findRequest(const DecodedImage& image)
+    {
+        auto key = keys.find(image.id);
+        if (key == keys.end())
+            return nullptr;
+        auto it = entries.find(key->second);
+        return it != entries.end() && it->second.request == image.request ? &it->second : nullptr;
+    }
+
+    void upload(DecodedImage& image)
+    {
+        if (!findRequest(image))
+        {
+            // released before its pixels arrived
+            if (image.pixels)
+                stbi_image_free(image.pixels);
+            return;
+        }
+        if (!image.pixels)
+        {
+            cout << "STB FAILED: " << image.path << endl;
+            decodeFailed.insert(image.id);
+            return;
+        }
+        cout << "STB SUCCESS: " << image.path << " (" << image.width << "x" << image.height << ", " << image.channels << " channels)" << endl;
+
+        GLenum format = GL_RGBA, internalFormat = GL_RGBA8;
+        if (image.channels == 1) { format = GL_RED; internalFormat = GL_R8; }
+        else if (image.channels == 2) { format = GL_RG; internalFormat = GL_RG8; }
+        else if (image.channels == 3) { format = GL_RGB; internalFormat = GL_RGB8; }
+
+        // the PBO is re-specified per upload, so we never wait for the previous transfer
+        size_t size = (size_t)image.width * image.height * image.channels;
+        if (PBO == 0)
+            glGenBuffers(1, &PBO);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, PBO);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped)
+        {
+            memcpy(mapped, image.pixels, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        }
+        stbi_image_free(image.pixels);
+
+        int levels = image.settings.mipmaps ? (int)floor(log2((double)max(image.width, image.height))) + 1 : 1;
+        GetGLState().BindTexture(0, image.id);
+        glTexStorage2D(GL_TEXTURE_2D, levels, internalFormat, image.width, image.height);
+        if (mapped)
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, format, GL_UNSIGNED_BYTE, (void*)0);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (image.settings.mipmaps)
+            glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, image.settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, image.settings.wrap);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, image.settings.minFilter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, image.settings.magFilter);
+        placeholders.erase(image.id);
+    }
+};
+
+#endif
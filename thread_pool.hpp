@@ -0,0 +1,173 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Multi-producer single-consumer queue (Vyukov's intrusive design). Workers push
+// results without taking a lock; only the GL thread pops.
+template <typename T>
+class MPSCQueue
+{
+public:
+    MPSCQueue()
+    {
+        Node* stub = new Node();
+        head.store(stub);
+        tail = stub;
+    }
+
+    ~MPSCQueue()
+    {
+        T discarded;
+        while (TryPop(discarded)) {}
+        delete tail;
+    }
+
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue& operator=(const MPSCQueue&) = delete;
+
+    void Push(T value)
+    {
+        Node* node = new Node();
+        node->value = move(value);
+        Node* previous = head.exchange(node, memory_order_acq_rel);
+        previous->next.store(node, memory_order_release);
+    }
+
+    // Consumer side only. May miss an item whose producer is halfway through Push;
+    // it shows up on a later call.
+    bool TryPop(T& value)
+    {
+        Node* next = tail->next.load(memory_order_acquire);
+        if (!next)
+            return false;
+        value = move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+
+private:
+    struct Node
+    {
+        atomic<Node*> next{ nullptr };
+        T value;
+    };
+
+    atomic<Node*> head;
+    Node* tail;
+};
+
+// Fixed set of worker threads running submitted jobs in FIFO order. Jobs must not
+// touch GL; hand results back to the GL thread through an MPSCQueue instead.
+class ThreadPool
+{
+public:
+    ThreadPool(unsigned int threadCount)
+    {
+        for (unsigned int i = 0; i < max(threadCount, 1u); i++)
+            workers.emplace_back([this] { run(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            lock_guard<mutex> lock(jobsMutex);
+            stopping = true;
+        }
+        jobsReady.notify_all();
+        for (thread& worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int GetThreadCount() const { return workers.size(); }
+
+    void Submit(function<void()> job)
+    {
+        {
+            lock_guard<mutex> lock(jobsMutex);
+            jobs.push_back(move(job));
+        }
+        jobsReady.notify_one();
+    }
+
+private:
+    vector<thread> workers;
+    deque<function<void()>> jobs;
+    mutex jobsMutex;
+    condition_variable jobsReady;
+    bool stopping = false;
+
+    void run()
+    {
+        for (;;)
+        {
+            function<void()> job;
+            {
+                unique_lock<mutex> lock(jobsMutex);
+                jobsReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+                if (stopping && jobs.empty())
+                    return;
+                job = move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+
+// Shared by all background loading; one thread is left for the GL thread.
+inline ThreadPool& GetThreadPool()
+{
+    static ThreadPool pool(max(thread::hardware_concurrency(), 2u) - 1);
+    return pool;
+}
+
+// Runs body(0) .. body(count - 1) across the pool and the calling thread, returning
+// once every index is done. Indices are claimed from a shared counter, so the caller
+// finishes the work alone if the workers are busy (e.g. importing). Helpers that
+// start after the counter ran out return without calling body.
+inline void ParallelFor(unsigned int count, function<void(unsigned int)> body)
+{
+    struct Work
+    {
+        function<void(unsigned int)> body;
+        unsigned int count;
+        atomic<unsigned int> next{ 0 };
+        atomic<unsigned int> done{ 0 };
+
+        void Run()
+        {
+            for (unsigned int i = next++; i < count; i = next++)
+            {
+                body(i);
+                done++;
+            }
+        }
+    };
+    if (count == 0)
+        return;
+    shared_ptr<Work> work = make_shared<Work>();
+    work->body = move(body);
+    work->count = count;
+    unsigned int helpers = min(GetThreadPool().GetThreadCount(), count - 1);
+    for (unsigned int i = 0; i < helpers; i++)
+        GetThreadPool().Submit([work] { work->Run(); });
+    work->Run();
+    while (work->done.load() < count)
+        this_thread::yield();
+}
+
+#endif
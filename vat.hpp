@@ -0,0 +1,65 @@
+#ifndef VAT_HPP
+#define VAT_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <model.hpp>
+#include <cmath>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// A clip baked into an RGBA32F texture: one row per frame, four texels (matrix
+// columns) per bone. crowd.vert fetches the palette itself, so instances drawn
+// through it cost no CPU animation work at all.
+struct BakedAnimation
+{
+    unsigned int texture = 0;
+    int boneCount = 0;
+    int frameCount = 0;
+    float framesPerSecond = 0.0f;
+};
+
+BakedAnimation BakeAnimationTexture(Model& model, int clipIndex, float framesPerSecond = 30.0f)
+{
+    BakedAnimation baked;
+    const AnimationClip& clip = model.GetAnimation(clipIndex);
+    baked.boneCount = model.GetBoneCount();
+    float durationSeconds = clip.GetDurationSeconds();
+    baked.frameCount = max(1, (int)ceil(durationSeconds * framesPerSecond));
+    // frameCount frames spread over exactly one clip, so the loop wraps when the CPU path does
+    baked.framesPerSecond = durationSeconds > 0.0f ? baked.frameCount / durationSeconds : framesPerSecond;
+
+    int width = baked.boneCount * 4;
+    vector<float> texels((size_t)width * baked.frameCount * 4);
+    vector<glm::mat4> transforms(baked.boneCount, glm::mat4(1.0f));
+    AnimationCursor cursor;
+    for (int frame = 0; frame < baked.frameCount; frame++)
+    {
+        float animationTime = fmod(frame / baked.framesPerSecond * clip.ticksPerSecond, clip.duration);
+        model.EvaluatePose(clipIndex, animationTime, cursor, transforms);
+
+        float* row = &texels[(size_t)frame * width * 4];
+        for (int bone = 0; bone < baked.boneCount; bone++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                for (int i = 0; i < 4; i++)
+                    row[(bone * 4 + column) * 4 + i] = transforms[bone][column][i];
+            }
+        }
+    }
+
+    glGenTextures(1, &baked.texture);
+    GetGLState().BindTexture(0, baked.texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, baked.frameCount, 0, GL_RGBA, GL_FLOAT, texels.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    cout << "DEBUG: Baked " << clip.name << " into " << width << "x" << baked.frameCount << " bone texture (" << baked.boneCount << " bones)" << endl;
+    return baked;
+}
+
+#endif
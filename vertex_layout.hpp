@@ -0,0 +1,246 @@
+#ifndef VERTEX_LAYOUT_HPP
+#define VERTEX_LAYOUT_HPP
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+#define MAX_BONE_INFLUENCE 4
+
+// Import-time vertex. Meshes keep this on the CPU and pack it into one of the
+// VertexLayouts below before uploading.
+struct Vertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texCoords;
+    glm::vec3 tangent;
+    glm::vec3 bitangent;
+
+    int m_BoneIDs[MAX_BONE_INFLUENCE];
+    float m_Weights[MAX_BONE_INFLUENCE];
+
+    void SetBoneDataDefault()
+    {
+        for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+        {
+            m_BoneIDs[i] = -1;
+            m_Weights[i] = 0.0f;
+        }
+    }
+};
+
+// Full is the original 88 byte float layout. Skinned (32 bytes) and Static
+// (24 bytes) pack normals and tangents as snorm 10:10:10:2 (tangent.w holds the
+// bitangent sign), UVs as half floats, bone IDs as uint8 and weights as unorm8.
+// Auto lets the importer choose Skinned or Static per model.
+enum class VertexFormat
+{
+    Auto,
+    Full,
+    Skinned,
+    Static
+};
+
+enum class VertexSemantic
+{
+    Position,
+    Normal,
+    TexCoord,
+    Tangent,
+    Bitangent,
+    BoneIDs,
+    BoneWeights
+};
+
+struct VertexAttribute
+{
+    VertexSemantic semantic;
+    unsigned int location;
+    int components;
+    GLenum type;
+    GLboolean normalized;
+    bool integer;
+    unsigned int offset;
+};
+
+struct VertexLayout
+{
+    VertexFormat format;
+    unsigned int stride;
+    vector<VertexAttribute> attributes;
+
+    bool HasSkinning() const
+    {
+        for (const VertexAttribute& attribute : attributes)
+            if (attribute.semantic == VertexSemantic::BoneIDs)
+                return true;
+        return false;
+    }
+};
+
+inline const VertexLayout& GetVertexLayout(VertexFormat format)
+{
+    static const VertexLayout full = { VertexFormat::Full, sizeof(Vertex), {
+        { VertexSemantic::Position,    0, 3, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, position) },
+        { VertexSemantic::Normal,      1, 3, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, normal) },
+        { VertexSemantic::TexCoord,    2, 2, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, texCoords) },
+        { VertexSemantic::Tangent,     3, 3, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, tangent) },
+        { VertexSemantic::Bitangent,   4, 3, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, bitangent) },
+        { VertexSemantic::BoneIDs,     5, 4, GL_INT,   GL_FALSE, true,  offsetof(Vertex, m_BoneIDs) },
+        { VertexSemantic::BoneWeights, 6, 4, GL_FLOAT, GL_FALSE, false, offsetof(Vertex, m_Weights) },
+    } };
+    static const VertexLayout skinned = { VertexFormat::Skinned, 32, {
+        { VertexSemantic::Position,    0, 3, GL_FLOAT,                       GL_FALSE, false, 0 },
+        { VertexSemantic::Normal,      1, 4, GL_INT_2_10_10_10_REV,          GL_TRUE,  false, 12 },
+        { VertexSemantic::TexCoord,    2, 2, GL_HALF_FLOAT,                  GL_FALSE, false, 16 },
+        { VertexSemantic::Tangent,     3, 4, GL_INT_2_10_10_10_REV,          GL_TRUE,  false, 20 },
+        { VertexSemantic::BoneIDs,     5, 4, GL_UNSIGNED_BYTE,               GL_FALSE, true,  24 },
+        { VertexSemantic::BoneWeights, 6, 4, GL_UNSIGNED_BYTE,               GL_TRUE,  false, 28 },
+    } };
+    static const VertexLayout staticLayout = { VertexFormat::Static, 24, {
+        { VertexSemantic::Position,    0, 3, GL_FLOAT,                       GL_FALSE, false, 0 },
+        { VertexSemantic::Normal,      1, 4, GL_INT_2_10_10_10_REV,          GL_TRUE,  false, 12 },
+        { VertexSemantic::TexCoord,    2, 2, GL_HALF_FLOAT,                  GL_FALSE, false, 16 },
+        { VertexSemantic::Tangent,     3, 4, GL_INT_2_10_10_10_REV,          GL_TRUE,  false, 20 },
+    } };
+
+    switch (format)
+    {
+    case VertexFormat::Skinned: return skinned;
+    case VertexFormat::Static: return staticLayout;
+    default: return full;
+    }
+}
+
+inline uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (exponent <= 0)
+    {
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        return sign | (mantissa >> (14 - exponent));
+    }
+    if (exponent >= 31)
+        return sign | 0x7c00;
+
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000)
+        half++; // round to nearest; a carry into the exponent is still correct
+    return half;
+}
+
+// x, y, z in [-1, 1] as snorm10, w in [-1, 1] as snorm2
+inline uint32_t packSnorm1010102(glm::vec3 v, float w)
+{
+    auto snorm = [](float value, float scale, uint32_t mask)
+    {
+        return (uint32_t)(int)roundf(glm::clamp(value, -1.0f, 1.0f) * scale) & mask;
+    };
+    return snorm(v.x, 511.0f, 0x3ff) | (snorm(v.y, 511.0f, 0x3ff) << 10) | (snorm(v.z, 511.0f, 0x3ff) << 20) | (snorm(w, 1.0f, 0x3) << 30);
+}
+
+// Quantizes weights to unorm8 so they still sum to exactly 255.
+inline void packWeights(const float* weights, uint8_t* packed)
+{
+    int total = 0;
+    int largest = 0;
+    for (int i = 0; i < MAX_BONE_INFLUENCE; i++)
+    {
+        packed[i] = (uint8_t)glm::clamp(roundf(weights[i] * 255.0f), 0.0f, 255.0f);
+        total += packed[i];
+        if (weights[i] > weights[largest])
+            largest = i;
+    }
+    if (total > 0)
+        packed[largest] = (uint8_t)glm::clamp(packed[largest] + (255 - total), 0, 255);
+}
+
+inline vector<unsigned char> packVertices(const vector<Vertex>& vertices, const VertexLayout& layout)
+{
+    vector<unsigned char> data((size_t)vertices.size() * layout.stride);
+    if (layout.format == VertexFormat::Full)
+    {
+        if (!vertices.empty())
+            memcpy(data.data(), vertices.data(), data.size());
+        return data;
+    }
+
+    for (size_t i = 0; i < vertices.size(); i++)
+    {
+        const Vertex& vertex = vertices[i];
+        unsigned char* out = &data[i * layout.stride];
+        for (const VertexAttribute& attribute : layout.attributes)
+        {
+            unsigned char* dst = out + attribute.offset;
+            switch (attribute.semantic)
+            {
+            case VertexSemantic::Position:
+                memcpy(dst, &vertex.position, sizeof(glm::vec3));
+                break;
+            case VertexSemantic::Normal:
+            {
+                uint32_t packed = packSnorm1010102(vertex.normal, 0.0f);
+                memcpy(dst, &packed, sizeof(packed));
+                break;
+            }
+            case VertexSemantic::TexCoord:
+            {
+                uint16_t packed[2] = { floatToHalf(vertex.texCoords.x), floatToHalf(vertex.texCoords.y) };
+                memcpy(dst, packed, sizeof(packed));
+                break;
+            }
+            case VertexSemantic::Tangent:
+            {
+                // the bitangent is rebuilt as cross(normal, tangent) * w
+                float sign = glm::dot(glm::cross(vertex.normal, vertex.tangent), vertex.bitangent) < 0.0f ? -1.0f : 1.0f;
+                uint32_t packed = packSnorm1010102(vertex.tangent, sign);
+                memcpy(dst, &packed, sizeof(packed));
+                break;
+            }
+            case VertexSemantic::BoneIDs:
+            {
+                // unused slots become bone 0 with weight 0
+                for (int j = 0; j < MAX_BONE_INFLUENCE; j++)
+                    dst[j] = (uint8_t)max(vertex.m_BoneIDs[j], 0);
+                break;
+            }
+            case VertexSemantic::BoneWeights:
+                packWeights(vertex.m_Weights, dst);
+                break;
+            case VertexSemantic::Bitangent:
+                break;
+            }
+        }
+    }
+    return data;
+}
+
+// Resolves Auto for a model: skinned when it has bones that fit in uint8 IDs,
+// the full layout when it has more, static otherwise.
+inline VertexFormat chooseVertexFormat(VertexFormat requested, int boneCount)
+{
+    if (requested == VertexFormat::Skinned && boneCount > 256)
+        return VertexFormat::Full;
+    if (requested != VertexFormat::Auto)
+        return requested;
+    if (boneCount == 0)
+        return VertexFormat::Static;
+    return boneCount <= 256 ? VertexFormat::Skinned : VertexFormat::Full;
+}
+
+#endif